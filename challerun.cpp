@@ -0,0 +1,4 @@
+﻿#include "challerun.h"
+
+// challerun.hで宣言したグローバル変数の実体
+Tracer *g_tracer = nullptr;
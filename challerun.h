@@ -0,0 +1,3189 @@
+﻿#ifndef CHALLERUN_H
+#define CHALLERUN_H
+
+// 探索部分(問題の読み込み・探索・解の表現)
+// コマンドラインのchallerunF.exeと、他のプログラムから使うためのライブラリ(challerun_c.h)の両方がこれを使う。
+// 問題は、ファイル名の他にistream(メモリ上の問題文)からも読み込める
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <functional>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <limits>
+#include <map>
+#include <memory>
+#include <numeric>
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <mutex>
+#include "ThreadPool.h"
+// 候補手の一括評価に使用する命令セット
+// CHALLERUN_SIMDを定義した場合のみ、AVX2(無ければSSE2)版を使用する。
+// 手元の計測(5x6盤面)ではスカラー版が最も速かったため、既定ではスカラー版とする
+#if defined(CHALLERUN_SIMD) && defined(__AVX2__)
+#define CHALLERUN_AVX2
+#include <immintrin.h>
+#elif defined(CHALLERUN_SIMD) && (defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2))
+#define CHALLERUN_SSE2
+#include <emmintrin.h>
+#endif
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+#ifdef _WIN32
+#define NOMINMAX
+#include <windows.h>
+#elif defined(__linux__)
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+using std::cout;
+using std::endl;
+using std::ostream;
+using std::string;
+using std::vector;
+
+class StopWatch {
+	std::chrono::system_clock::time_point start_time;
+	std::chrono::system_clock::time_point end_time;
+public:
+	// ストップウォッチを開始
+	void Start() noexcept{ start_time = std::chrono::system_clock::now(); }
+	// ストップウォッチを停止
+	void Stop() noexcept{ end_time = std::chrono::system_clock::now(); }
+	// 経過時間を返す
+	long long ElapsedNanoseconds() const noexcept {
+		return std::chrono::duration_cast<std::chrono::nanoseconds>(end_time - start_time).count();
+	}
+	long long ElapsedMicroseconds() const noexcept {
+		return std::chrono::duration_cast<std::chrono::microseconds>(end_time - start_time).count();
+	}
+	long long ElapsedMilliseconds() const noexcept {
+		return std::chrono::duration_cast<std::chrono::milliseconds>(end_time - start_time).count();
+	}
+};
+
+// 呼び出したスレッドを、指定した番号のCPUコアに固定する
+// (番号がコア数以上の場合は折り返す。固定できない環境では何もしない)
+inline void pin_thread(const unsigned int core_index) noexcept {
+	const unsigned int core_count = std::max(1u, std::thread::hardware_concurrency());
+	const unsigned int core = core_index % core_count;
+#ifdef _WIN32
+	if (core < sizeof(DWORD_PTR) * 8)
+		SetThreadAffinityMask(GetCurrentThread(), static_cast<DWORD_PTR>(1) << core);
+#elif defined(__linux__)
+	cpu_set_t cpu_set;
+	CPU_ZERO(&cpu_set);
+	CPU_SET(core, &cpu_set);
+	pthread_setaffinity_np(pthread_self(), sizeof(cpu_set), &cpu_set);
+#else
+	(void)core;
+#endif
+}
+
+// 探索関数が候補手を試す順番
+enum MoveOrder {
+	// 盤面データの順(通常の探索と同じ)
+	ORDER_BOARD,
+	// 演算の大きい順(掛け算の大きい順、次に足し算の大きい順)
+	ORDER_GAIN,
+	// 盤面データの逆順
+	ORDER_REVERSE,
+	// 乱数で決めた順
+	ORDER_RANDOM,
+};
+
+// ポートフォリオモードの、ワーカー1つ分の探索設定
+struct PortfolioConfig {
+	// 候補手を試す順番
+	MoveOrder order;
+	// 順番を乱数で決める際のシード
+	unsigned int seed;
+	// 角にゴールがある場合に、それ用の探索関数を使うか？
+	bool corner_goal_flg;
+	// 「board」「gain」「reverse」「random<シード>」の形の文字列から読み取る
+	// (末尾に「/flat」を付けると、角にゴールがあっても通常の探索関数を使う)
+	static PortfolioConfig parse(string str) {
+		PortfolioConfig config{ ORDER_BOARD, 0, true };
+		const auto pos = str.find('/');
+		if (pos != string::npos) {
+			if (str.substr(pos) != "/flat")
+				throw "ポートフォリオの探索設定が間違っています。";
+			config.corner_goal_flg = false;
+			str = str.substr(0, pos);
+		}
+		if (str == "gain") {
+			config.order = ORDER_GAIN;
+		}
+		else if (str == "reverse") {
+			config.order = ORDER_REVERSE;
+		}
+		else if (str.compare(0, 6, "random") == 0 && str.size() > 6) {
+			config.order = ORDER_RANDOM;
+			config.seed = static_cast<unsigned int>(std::stoul(str.substr(6)));
+		}
+		else if (str != "board") {
+			throw "ポートフォリオの探索設定が間違っています。";
+		}
+		return config;
+	}
+	// 文字列化
+	string str() const {
+		string str = (order == ORDER_GAIN ? "gain" : order == ORDER_REVERSE ? "reverse" : order == ORDER_RANDOM ? "random" + std::to_string(seed) : "board");
+		return (corner_goal_flg ? str : str + "/flat");
+	}
+	// workers個のワーカー用の、既定の探索設定の一覧を返す
+	// (先頭は通常の探索と同じ設定にし、以降は並べ方・探索関数を変え、足りない分は乱数の並べ方で埋める)
+	static vector<PortfolioConfig> get_default_list(const size_t workers) {
+		const PortfolioConfig fixed_list[] = {
+			{ ORDER_BOARD, 0, true }, { ORDER_GAIN, 0, true }, { ORDER_BOARD, 0, false }, { ORDER_REVERSE, 0, true },
+		};
+		vector<PortfolioConfig> config_list;
+		for (size_t i = 0; i < workers; ++i) {
+			if (i < sizeof(fixed_list) / sizeof(fixed_list[0]))
+				config_list.push_back(fixed_list[i]);
+			else
+				config_list.push_back(PortfolioConfig{ ORDER_RANDOM, static_cast<unsigned int>(i), true });
+		}
+		return config_list;
+	}
+};
+
+// 演算データ
+// 数値を×mul_num＋add_numする役割を担う
+struct Operation {
+	// 掛け算する定数
+	int mul_num = 1;
+	// 足し算する定数
+	int add_num = 0;
+	int add_num_x = 0;	//add_numが1以上ならadd_num、0以下なら0とする
+	// 文字列化
+	string str() const noexcept {
+		if (add_num == 0) {
+			if (mul_num != 1) {
+				return "*" + std::to_string(mul_num);
+			}
+			else {
+				return "";
+			}
+		}
+		else if (add_num > 0) {
+			return "+" + std::to_string(add_num);
+		}
+		else {
+			return "-" + std::to_string(std::abs(add_num));
+		}
+	}
+	// 計算を適用
+	inline int calc(const int x) const noexcept {
+		return x * mul_num + add_num;
+	}
+	// 2つのOperationを合体させる(非可換)
+	// 「Operation1 + Operation2」を、「Operation1の後にOperation2を適用する」といった意味とする
+	const Operation operator + (const Operation& b) const {
+		// Operation1をM1*X+A1、Operation2をM2*X+A2とする。
+		// Operation1→Operation2の順で適用すると、
+		// M2*(M1*X+A1)+A2=M1*M2*X+A1*M2+A2 となる
+		const int mul_num2 = this->mul_num * b.mul_num;
+		const int add_num2 = this->add_num * b.mul_num + b.add_num;
+		return Operation{ mul_num2, add_num2, (add_num2 > 0 ? add_num2 : 0) };
+	}
+};
+// 移動方向(上・右・下・左)のコード
+// 経路を1歩あたり2bitで記録するのに使う
+enum StepCode : unsigned char {
+	STEP_UP = 0, STEP_RIGHT = 1, STEP_DOWN = 2, STEP_LEFT = 3,
+};
+// 地点Aから隣接する地点Bへ移動する際のコードを返す
+inline unsigned int get_step_code(const size_t point_a, const size_t point_b, const size_t width) noexcept {
+	if (point_b + width == point_a)
+		return STEP_UP;
+	if (point_a + 1 == point_b)
+		return STEP_RIGHT;
+	if (point_a + width == point_b)
+		return STEP_DOWN;
+	return STEP_LEFT;
+}
+// 地点からコードの方向へ1歩移動した先を返す
+inline size_t move_position(const size_t point, const unsigned int step, const size_t width) noexcept {
+	switch (step) {
+	case STEP_UP:
+		return point - width;
+	case STEP_RIGHT:
+		return point + 1;
+	case STEP_DOWN:
+		return point + width;
+	default:
+		return point - 1;
+	}
+}
+// 方向データ
+struct Direction {
+	// 行き先
+	size_t next_position;
+	// 辺の番号
+	size_t side_index;
+	// 辺の情報
+	Operation operation;
+	// 移動方向
+	unsigned int step;
+};
+// 方向データ(探索用・1歩編)
+// 探索関数が1歩進める・戻す際に必要な情報を、全て1つにまとめたもの
+// (全頂点分を頂点の順に1本の配列へ詰めて持ち、頂点pの分はoffset[p]～offset[p+1]-1番目になる)
+struct Move1 {
+	// 行き先
+	uint16_t next_position;
+	// 辺の番号
+	uint16_t side_index;
+	// 移動方向
+	unsigned char step;
+	// 演算
+	int mul_num, add_num;
+	// 獲得可能な得点の上限を算出するための数値の変化量
+	// (max_mul_value_はbound_mul_numで割り、max_add_value_はbound_add_numだけ引く)
+	int bound_mul_num, bound_add_num;
+};
+// 1頂点分の方向データ(探索用・1歩編)
+struct Direction1List {
+	const Move1 *first, *last;
+	const Move1* begin() const noexcept { return first; }
+	const Move1* end() const noexcept { return last; }
+};
+// 方向データ(探索用・2歩編)
+// 2歩分の移動に必要な情報を、1候補あたり24バイトにまとめたもの
+// (全頂点分を頂点の順に1本の配列へ詰めて持ち、頂点pの分はoffset[p]～offset[p+1]-1番目になる)
+struct Move2 {
+	// 行き先・辺の番号(1歩目)
+	uint16_t next_position2, side_index1;
+	// 辺の番号(2歩目)・移動方向(1歩目・2歩目)
+	uint16_t side_index2;
+	unsigned char step1, step2;
+	// 2辺を合成した演算
+	int mul_num, add_num;
+	// 2辺を通った際の、獲得可能な得点の上限を算出するための数値の変化量
+	// (max_mul_value_はbound_mul_numで割り、max_add_value_はbound_add_numだけ引く)
+	int bound_mul_num, bound_add_num;
+	// 候補を作る
+	static Move2 make(const Direction &next1, const Direction &next2) noexcept {
+		const Operation operation = next1.operation + next2.operation;
+		return Move2{ static_cast<uint16_t>(next2.next_position), static_cast<uint16_t>(next1.side_index),
+			static_cast<uint16_t>(next2.side_index), static_cast<unsigned char>(next1.step), static_cast<unsigned char>(next2.step),
+			operation.mul_num, operation.add_num,
+			next1.operation.mul_num * next2.operation.mul_num, next1.operation.add_num_x + next2.operation.add_num_x };
+	}
+};
+#if defined(CHALLERUN_AVX2) || defined(CHALLERUN_SSE2)
+// 方向データ(探索用・2歩編)を、候補8個ずつstructure-of-arraysにまとめたもの
+// (SIMD版では、1グループ=8レーンをそのままレジスタに読み込んで評価する)
+struct Move2Group {
+	static const size_t lanes = 8;
+	uint16_t next_position2[lanes];
+	uint16_t side_index1[lanes], side_index2[lanes];
+	unsigned char step1[lanes], step2[lanes];
+	int mul_num[lanes], add_num[lanes];
+	int bound_mul_num[lanes], bound_add_num[lanes];
+};
+// 1頂点分の方向データ(探索用・2歩編)
+// (候補の有無はビットマスクで表すので、1頂点あたり16通りまでとする。格子盤面では高々4*3=12通り)
+struct Direction2List {
+	static const size_t capacity = 16;
+	typedef Move2Group Entry;
+	const Entry *first;
+	// 候補の数
+	size_t size;
+	// i番目の候補
+	Move2 operator [] (const size_t i) const noexcept {
+		const Entry &group = first[i / Entry::lanes];
+		const size_t k = i % Entry::lanes;
+		return Move2{ group.next_position2[k], group.side_index1[k], group.side_index2[k], group.step1[k], group.step2[k],
+			group.mul_num[k], group.add_num[k], group.bound_mul_num[k], group.bound_add_num[k] };
+	}
+	// 頂点の候補一覧entry_listの末尾に、size番目の候補を追加する
+	// (使わないレーンは、添字0を指す候補のままにしておく)
+	static void push_back(vector<Entry> &entry_list, const size_t size, const Move2 &move) {
+		if (size % Entry::lanes == 0)
+			entry_list.push_back(Entry());
+		Entry &group = entry_list.back();
+		const size_t k = size % Entry::lanes;
+		group.next_position2[k] = move.next_position2;
+		group.side_index1[k] = move.side_index1;
+		group.side_index2[k] = move.side_index2;
+		group.step1[k] = move.step1;
+		group.step2[k] = move.step2;
+		group.mul_num[k] = move.mul_num;
+		group.add_num[k] = move.add_num;
+		group.bound_mul_num[k] = move.bound_mul_num;
+		group.bound_add_num[k] = move.bound_add_num;
+	}
+};
+#else
+// 1頂点分の方向データ(探索用・2歩編)
+// (スカラー版では、候補を1個ずつ読むので、1候補分のメンバーが隣り合っている方が速い)
+// (候補の有無はビットマスクで表すので、1頂点あたり16通りまでとする。格子盤面では高々4*3=12通り)
+struct Direction2List {
+	static const size_t capacity = 16;
+	typedef Move2 Entry;
+	const Entry *first;
+	// 候補の数
+	size_t size;
+	// i番目の候補
+	const Move2& operator [] (const size_t i) const noexcept {
+		return first[i];
+	}
+	// 頂点の候補一覧entry_listの末尾に、size番目の候補を追加する
+	static void push_back(vector<Entry> &entry_list, const size_t, const Move2 &move) {
+		entry_list.push_back(move);
+	}
+};
+#endif
+
+// 下位から見て最初に立っているビットの位置を返す(mask != 0であること)
+inline unsigned int bit_scan_forward(const unsigned int mask) noexcept {
+#ifdef _MSC_VER
+	unsigned long index;
+	_BitScanForward(&index, mask);
+	return static_cast<unsigned int>(index);
+#else
+	return static_cast<unsigned int>(__builtin_ctz(mask));
+#endif
+}
+
+// 問題データ
+class Problem {
+	// 頂点データ
+	// field_[マス目][各方向] = 方向データ
+	// [各方向]部分を可変長(vector)にしているのがポイント
+	vector<vector<Direction>> field_;
+	// 頂点データ(探索用・1歩編)
+	// field1_[field1_offset_[マス目]]～field1_[field1_offset_[マス目+1]-1] = 方向データ
+	vector<Move1> field1_;
+	vector<uint32_t> field1_offset_;
+	//頂点データ(探索用・2歩編)
+	// field2_[field2_offset_[マス目]]～field2_[field2_offset_[マス目+1]-1] = 方向データ
+	// field2_size_[マス目] = 候補の数
+	vector<Direction2List::Entry> field2_;
+	vector<uint32_t> field2_offset_;
+	vector<unsigned char> field2_size_;
+	// 辺データ
+	vector<Operation> side_;
+	// 盤面サイズ
+	size_t width_ = 0, height_ = 0;
+	// スタート・ゴール
+	size_t start_, goal_;
+	// 既存の経路
+	// 例えば<途中までの経路>が「1 0 8」だとスタート0・ゴール8・既存の経路「0」だが、
+	// 「4 0 3 6 7 8」だとスタート7・ゴール8・既存の経路「0→3→6→7」になる
+	vector<size_t> pre_root_;
+	// 既存の得点
+	// 起点における所持得点は1点だが、既存の経路に従って移動すると当然得点が変化する
+	int pre_score_ = 1;
+	// 既知の最良解の得点(問題ファイルに書かれていなければ-9999)
+	int known_score_ = -9999;
+	// field1_・field2_で、各頂点の候補手を並べる順番(乱数で決める場合はそのシードも持つ)
+	MoveOrder move_order_ = ORDER_BOARD;
+	unsigned int move_order_seed_ = 0;
+	// 地点A→地点Bに移動する際のインデックスを取得する
+	// 取得できない場合は-1を返す
+	int get_index(const size_t point_a, const size_t point_b)const noexcept{
+		int result = -1;
+		for (size_t i = 0; i < field_[point_a].size(); ++i) {
+			if (field_[point_a][i].next_position == point_b) {
+				result = static_cast<int>(i);
+				break;
+			}
+		}
+		return result;
+	}
+	void erase_root(const size_t point_a, const size_t point_b) {
+		const int index_ab = get_index(point_a, point_b);
+		const int index_ba = get_index(point_b, point_a);
+		if(index_ab >= 0)
+			field_[point_a].erase(field_[point_a].begin() + index_ab);
+		if (index_ba >= 0)
+		field_[point_b].erase(field_[point_b].begin() + index_ba);
+	}
+public:
+	// コンストラクタ
+	Problem(){}
+	Problem(const string file_name, const int start_position, const int goal_position) {
+		// ファイルを読み込む
+		std::ifstream ifs(file_name);
+		if (ifs.fail())
+			throw "ファイルを読み込めません。";
+		read(ifs, start_position, goal_position);
+	}
+	// (サーバーモードで、リクエストに含まれる問題文を読み込む際に使う)
+	Problem(std::istream &ifs, const int start_position, const int goal_position) {
+		read(ifs, start_position, goal_position);
+	}
+private:
+	// 問題文を読み込む
+	void read(std::istream &ifs, const int start_position, const int goal_position) {
+		try {
+			// 盤面サイズを読み込む
+			{
+				int width__, height__;
+				ifs >> width__ >> height__;
+				if (width__ < 1 || height__ < 1)
+					throw "盤面サイズが間違っています。";
+				// (探索用の方向データでは、地点・辺の番号を16bitで持つ)
+				if (2LL * width__ * height__ > 0xFFFF)
+					throw "盤面が大きすぎます。";
+				width_ = width__;
+				height_ = height__;
+			}
+			field_.resize(width_ * height_, vector<Direction>());
+			// (負の番号は省略を表す。盤面の外を指す番号はエラーにする)
+			const int point_count = static_cast<int>(width_ * height_);
+			if (start_position >= point_count || goal_position >= point_count)
+				throw "地点番号が盤面の範囲外です。";
+			start_ = (start_position >= 0 ? start_position : 0);
+			goal_ = (goal_position >= 0 ? goal_position : point_count - 1);
+			// 盤面を読み込む
+			for (size_t h = 0; h < height_ * 2 - 1; ++h) {
+				for (size_t w = 0; w < (h % 2 == 0 ? width_ - 1 : width_); ++w) {
+					if (ifs.eof())
+						throw "盤面データが足りません。";
+					// 一区切り(+1や-3や*7など)を読み込む
+					string token;
+					ifs >> token;
+					// 2文字目以降を数字と認識する
+					const int number = std::stoi(token.substr(1));
+					// 演算子を読み取り、それによって場合分けを行う
+					const string operation_str = token.substr(0, 1);
+					Operation ope;
+					if (operation_str == "+") {
+						ope.add_num = number;
+						ope.add_num_x = std::max(0, number);
+					}
+					else if (operation_str == "-") {
+						ope.add_num = -number;
+						ope.add_num_x = std::max(0, -number);
+					}
+					else if (operation_str == "*") {
+						ope.mul_num = number;
+					}
+					else {
+						throw "不明な演算子です。";
+					}
+					// field_およびsideに代入する
+					if (h % 2 == 0) {
+						{
+							// 横方向の経路─
+							size_t x = w;
+							size_t y = h / 2;
+							size_t p = y * width_ + x;
+							field_[p].push_back(Direction{ p + 1, side_.size(), ope, STEP_RIGHT });
+							field_[p + 1].push_back(Direction{ p, side_.size(), ope, STEP_LEFT });
+						}
+					}
+					else {
+						{
+							// 縦方向の経路│
+							size_t x = w;
+							size_t y = (h - 1) / 2;
+							size_t p = y * width_ + x;
+							field_[p].push_back(Direction{ p + width_, side_.size(), ope, STEP_DOWN });
+							field_[p + width_].push_back(Direction{ p, side_.size(), ope, STEP_UP });
+						}
+					}
+					side_.push_back(ope);
+				}
+			}
+			// スタート・移動経路・ゴールを読み込む
+			// (経路が書かれていない場合や、末尾に改行などがあるだけの場合は、スタート地点だけの経路とする)
+			int pre_root_size = 0;
+			if (!(ifs >> pre_root_size) || pre_root_size <= 0) {
+				pre_root_.push_back(start_);
+			}
+			else {
+				for (size_t i = 0; i < pre_root_size; ++i) {
+					int pre_root_pos;
+					ifs >> pre_root_pos;
+					if (pre_root_pos < 0 || pre_root_pos >= point_count)
+						throw "途中までの経路データが間違っています。";
+					pre_root_.push_back(pre_root_pos);
+				}
+				int pre_root_goal;
+				ifs >> pre_root_goal;
+				if (pre_root_goal < 0 || pre_root_goal >= point_count)
+					throw "途中までの経路データが間違っています。";
+				start_ = pre_root_[pre_root_size - 1];
+				goal_ = pre_root_goal;
+			}
+			// 既知の最良解を読み込む
+			// (「経路長・経路・得点」の形だが、経路の書き方が資料によって揺れているので、残りの数値の最後を得点とする。
+			//   経路は盤面と突き合わせないので、得点は目標スコアの候補としてだけ使う。解が無いことを表す値は無視する)
+			{
+				vector<int> known_root;
+				int value;
+				while (ifs >> value) {
+					known_root.push_back(value);
+				}
+				if (known_root.size() >= 2 && known_root.back() != std::numeric_limits<int>::min())
+					known_score_ = known_root.back();
+			}
+			// 移動経路における演算を行う
+			for (size_t i = 0; i + 1 < pre_root_.size(); ++i) {
+				const int index_sd = get_index(pre_root_[i], pre_root_[i + 1]);
+				if (index_sd < 0)
+					throw "途中までの経路データが間違っています。";
+				pre_score_ = side_[field_[pre_root_[i]][index_sd].side_index].calc(pre_score_);
+			}
+			// 読み取った移動経路に従い、問題を最適化する
+			optimize();
+			return;
+		}
+		catch (const char *s) {
+			throw s;
+		}
+		catch (...) {
+			throw "問題ファイルとして解釈できませんでした。";
+		}
+	}
+public:
+	// 辺の大きさを返す
+	size_t side_size() const noexcept {
+		return side_.size();
+	}
+	// 辺が使えるか否かを表すフラグ一覧(の初期値)を返す
+	vector<int> get_side_flg() const {
+		vector<int> side_flg;
+		get_side_flg(side_flg);
+		return side_flg;
+	}
+	void get_side_flg(vector<int> &side_flg) const {
+		side_flg.assign(side_.size(), 0);
+		for (const auto &point : field_) {
+			for (const auto &dir : point) {
+				side_flg[dir.side_index] = 1;
+			}
+		}
+		for (size_t i = 0; i < pre_root_.size() - 1; ++i) {
+			const auto index = get_index(pre_root_[i], pre_root_[i + 1]);
+			if(index >= 0)
+				side_flg[field_[pre_root_[i]][index].side_index] = 0;
+		}
+	}
+	// ある地点の周りにある、まだ通れる辺の数の初期値を返す
+	// (ただしゴール地点だけ+1しておく)
+	vector<int> get_available_side_count() const {
+		vector<int> available_side_count;
+		get_available_side_count(available_side_count);
+		return available_side_count;
+	}
+	void get_available_side_count(vector<int> &available_side_count) const {
+		available_side_count.resize(field_.size());
+		for (size_t i = 0; i < field_.size(); ++i) {
+			available_side_count[i] = static_cast<int>(field_[i].size());
+		}
+		available_side_count[goal_] += 1;
+	}
+	// 角にゴールがあるか？
+	// (スタートとゴールが同じ場合は、角から出て角へ戻る経路があり得るので対象外とする)
+	bool corner_goal_flg() const noexcept {
+		return corner_goal_flg(start_);
+	}
+	// (今いる地点がpositionの場合)
+	bool corner_goal_flg(const size_t position) const noexcept {
+		if (position == goal_)
+			return false;
+		return (goal_ == 0 || goal_ == width_ - 1 || goal_ == width_ * (height_ - 1) || goal_ == width_ * height_ - 1);
+	}
+	// 問題の奇偶を調べる
+	bool is_odd() const noexcept {
+		return is_odd(start_);
+	}
+	// (今いる地点がpositionの場合)
+	bool is_odd(const size_t position) const noexcept {
+		int sx = position % width_, sy = position / width_;
+		int gx = goal_ % width_, gy = goal_ / width_;
+		int x_flg = std::abs(sx - gx) % 2, y_flg = std::abs(sy - gy) % 2;
+		return ((x_flg + y_flg) % 2 == 1);
+	}
+	// スタート・ゴールを付け替える(途中までの経路が無い問題に限る)
+	void set_start_goal(const size_t start, const size_t goal) {
+		start_ = start;
+		goal_ = goal;
+		pre_root_.assign(1, start);
+		pre_score_ = 1;
+	}
+	// 地点の一覧を表す文字列を解釈する
+	// 「all」なら全地点、「border」なら盤面の縁にある地点、それ以外は「0,5,7」のようなカンマ区切りの地点番号
+	vector<size_t> get_point_list(const string &str) const {
+		vector<size_t> point_list;
+		for (size_t p = 0; p < width_ * height_; ++p) {
+			const size_t x = p % width_, y = p / width_;
+			if (str == "all" || (str == "border" && (x == 0 || x == width_ - 1 || y == 0 || y == height_ - 1)))
+				point_list.push_back(p);
+		}
+		if (str == "all" || str == "border")
+			return point_list;
+		std::istringstream iss(str);
+		string token;
+		while (std::getline(iss, token, ',')) {
+			const int point = std::stoi(token);
+			if (point < 0 || point >= static_cast<int>(width_ * height_))
+				throw "地点番号が盤面の範囲外です。";
+			point_list.push_back(point);
+		}
+		if (point_list.empty())
+			throw "地点の一覧が空です。";
+		return point_list;
+	}
+	// 今いる地点から、まだ通っていない辺でnext_positionへ移動できるか？
+	bool can_move(const size_t next_position) const {
+		const auto side_flg = get_side_flg();
+		for (const auto &dir : field_[start_]) {
+			if (dir.next_position == next_position && side_flg[dir.side_index])
+				return true;
+		}
+		return false;
+	}
+	// 途中までの経路に従い、問題を最適化する(field1_・field2_もここで作り直す)
+	// ・途中までの経路で使った演算子を削除する
+	// ・その結果生じた「使用できない演算子」(スタート・ゴール以外の、行き止まりに続く辺)を削除する
+	// (移動操作の後に呼べば、その経路が書かれた問題ファイルを読み込んだ場合と同じ状態になる)
+	void optimize() {
+		if (pre_root_.size() > 1) {
+			// 移動経路で使用した部分を削除する
+			for (size_t i = 0; i < pre_root_.size() - 1; ++i) {
+				erase_root(pre_root_[i], pre_root_[i + 1]);
+			}
+			// 移動後に生じた「使用できない演算子」を削除して回る
+			bool erease_flg;
+			do {
+				erease_flg = false;
+				for (size_t y = 0; y < height_; ++y) {
+					for (size_t x = 0; x < width_; ++x) {
+						size_t pos_src = y * width_ + x;
+						if (field_[pos_src].size() == 1 && pos_src != start_ && pos_src != goal_) {
+							size_t pos_dst = field_[pos_src][0].next_position;
+							erase_root(pos_src, pos_dst);
+							erease_flg = true;
+							break;
+						}
+					}
+					if (erease_flg)
+						break;
+				}
+			} while (erease_flg);
+		}
+		make_move_table();
+	}
+private:
+	// 候補手の一覧を、move_order_の順番に並べ替える
+	template<class Move>
+	void sort_move_list(vector<Move> &move_list, std::mt19937 &rand) const {
+		switch (move_order_) {
+		case ORDER_GAIN:
+			std::stable_sort(move_list.begin(), move_list.end(), [](const Move &a, const Move &b) {
+				return (a.mul_num != b.mul_num ? a.mul_num > b.mul_num : a.add_num > b.add_num);
+			});
+			break;
+		case ORDER_REVERSE:
+			std::reverse(move_list.begin(), move_list.end());
+			break;
+		case ORDER_RANDOM:
+			std::shuffle(move_list.begin(), move_list.end(), rand);
+			break;
+		default:
+			break;
+		}
+	}
+	// field_から、探索用の方向データ(field1_・field2_)を作る
+	void make_move_table() {
+		std::mt19937 rand(move_order_seed_);
+		// field1_を作成する
+		field1_.clear();
+		field1_offset_.assign(1, 0);
+		vector<Move1> move1_list;
+		for (size_t p = 0; p < width_ * height_; ++p) {
+			move1_list.clear();
+			for (const auto &next : field_[p]) {
+				const auto &operation = next.operation;
+				move1_list.push_back(Move1{ static_cast<uint16_t>(next.next_position), static_cast<uint16_t>(next.side_index), static_cast<unsigned char>(next.step),
+					operation.mul_num, operation.add_num, operation.mul_num, operation.add_num_x });
+			}
+			sort_move_list(move1_list, rand);
+			field1_.insert(field1_.end(), move1_list.begin(), move1_list.end());
+			field1_offset_.push_back(static_cast<uint32_t>(field1_.size()));
+		}
+		// field2_を作成する
+		field2_.clear();
+		field2_offset_.assign(1, 0);
+		field2_size_.assign(width_ * height_, 0);
+		vector<Move2> move2_list;
+		for (size_t p = 0; p < width_ * height_; ++p) {
+			move2_list.clear();
+			for (const auto &next1 : field_[p]) {
+				for (const auto &next2 : field_[next1.next_position]) {
+					if (next2.next_position == p)
+						continue;
+					if (move2_list.size() >= Direction2List::capacity)
+						throw "1地点あたりの移動候補が多すぎます。";
+					move2_list.push_back(Move2::make(next1, next2));
+				}
+			}
+			sort_move_list(move2_list, rand);
+			for (size_t i = 0; i < move2_list.size(); ++i) {
+				Direction2List::push_back(field2_, i, move2_list[i]);
+			}
+			field2_size_[p] = static_cast<unsigned char>(move2_list.size());
+			field2_offset_.push_back(static_cast<uint32_t>(field2_.size()));
+		}
+	}
+public:
+	// 移動操作
+	void move(const size_t next_position) {
+		pre_root_.push_back(next_position);
+		pre_score_ = side_[field_[start_][get_index(start_, next_position)].side_index].calc(pre_score_);
+		start_ = next_position;
+	}
+	// 保存用に書き出す
+	// (routeを渡した場合は、途中までの経路の後ろにrouteの地点を付け足したものとして書き出す)
+	string to_file(const vector<size_t> &route = vector<size_t>()) const {
+		std::ostringstream oss;
+		oss << width_ << " " << height_ << endl;
+		size_t p = 0;
+		for (size_t h = 0; h < height_ * 2 - 1; ++h) {
+			for (size_t w = 0; w < (h % 2 == 0 ? width_ - 1 : width_); ++w) {
+				if (w != 0) oss << " ";
+				oss << side_[p].str();
+				++p;
+			}
+			oss << endl;
+		}
+		oss << pre_root_.size() + route.size() << " ";
+		for (size_t i = 0; i < pre_root_.size(); ++i) {
+			oss << pre_root_[i] << " ";
+		}
+		for (size_t i = 0; i < route.size(); ++i) {
+			oss << route[i] << " ";
+		}
+		oss << goal_ << endl;
+		return oss.str();
+	}
+	// 獲得可能な得点の上限(見込みスコア)を返す
+	int get_upper_score() const {
+		int max_mul_value, max_add_value;
+		get_muladd_value(get_side_flg(), max_mul_value, max_add_value);
+		// (Solver::get_upper_score()と同じく、負の場合は掛け算しない方が良い)
+		const int x = pre_score_ + max_add_value;
+		return (x < 0 ? x : x * max_mul_value);
+	}
+	// 獲得可能な得点の上限を算出するための数値
+	void get_muladd_value(const vector<int> &side_flg, int &max_mul_value, int &max_add_value) const noexcept {
+		// 初期値
+		max_mul_value = 1; max_add_value = 0;
+		// 各辺についてチェックする
+		for (size_t i = 0; i < side_.size(); ++i) {
+			if (!side_flg[i])
+				continue;
+			if (side_[i].add_num != 0) {
+				// 加減算
+				max_add_value += std::max(0, side_[i].add_num);
+			}
+			else if(side_[i].mul_num != 0){
+				// 乗算
+				max_mul_value *= std::max(1, side_[i].mul_num);
+			}
+		}
+	}
+	// getter
+	size_t get_start() const noexcept {
+		return start_;
+	}
+	size_t get_goal() const noexcept {
+		return goal_;
+	}
+	size_t get_width() const noexcept {
+		return width_;
+	}
+	size_t get_height() const noexcept {
+		return height_;
+	}
+	auto &get_pre_root() const noexcept {
+		return pre_root_;
+	}
+	const vector<Direction>& get_dir_list(const size_t point) const noexcept {
+		return field_[point];
+	}
+	Direction1List get_dir_list1(const size_t point) const noexcept {
+		return Direction1List{ field1_.data() + field1_offset_[point], field1_.data() + field1_offset_[point + 1] };
+	}
+	Direction2List get_dir_list2(const size_t point) const noexcept {
+		return Direction2List{ field2_.data() + field2_offset_[point], field2_size_[point] };
+	}
+	const Operation& get_operation(const size_t side_index) const noexcept {
+		return side_[side_index];
+	}
+	int get_pre_score() const noexcept {
+		return pre_score_;
+	}
+	int get_known_score() const noexcept {
+		return known_score_;
+	}
+	// 探索関数が候補手を試す順番を変える(orderがORDER_RANDOMの場合は、seedで順番を決める)
+	void set_move_order(const MoveOrder order, const unsigned int seed) {
+		move_order_ = order;
+		move_order_seed_ = seed;
+		make_move_table();
+	}
+	// 出力用(等幅フォント用)
+	friend ostream& operator << (ostream& os, const Problem& problem) {
+		cout << "【問題】" << endl;
+		cout << "盤面の規模：" << problem.width_ << "x" << problem.height_ << endl;
+		cout << "初期得点：" << problem.pre_score_ << endl;
+		// リッチな表示にするため、表示用の文字列配列を用意
+		vector<vector<string>> output_board(problem.height_ * 2 + 1, vector<string>(problem.width_ * 2 + 1));
+		// とりあえず枠線を割り当てる
+		output_board[0][0] = "┌";
+		output_board[0][problem.width_ * 2] = "┐";
+		output_board[problem.height_ * 2][0] = "└";
+		output_board[problem.height_ * 2][problem.width_ * 2] = "┘";
+		for (size_t i = 0; i < problem.width_ - 1; ++i) {
+			output_board[0][i * 2 + 2] = "┬";
+			output_board[problem.height_ * 2][i * 2 + 2] = "┴";
+		}
+		for (size_t i = 0; i < problem.height_ - 1; ++i) {
+			output_board[i * 2 + 2][0] = "├";
+			output_board[i * 2 + 2][problem.width_ * 2] = "┤";
+		}
+		for (size_t j = 0; j < problem.height_ - 1; ++j) {
+			for (size_t i = 0; i < problem.width_ - 1; ++i) {
+				output_board[j * 2 + 2][i * 2 + 2] = "┼";
+			}
+		}
+		for (size_t j = 0; j < problem.height_ + 1; ++j) {
+			for (size_t i = 0; i < problem.width_; ++i) {
+				output_board[j * 2][i * 2 + 1] = "─";
+			}
+		}
+		for (size_t j = 0; j < problem.height_; ++j) {
+			for (size_t i = 0; i < problem.width_ + 1; ++i) {
+				output_board[j * 2 + 1][i * 2] = "│";
+			}
+		}
+		for (size_t j = 0; j < problem.height_; ++j) {
+			for (size_t i = 0; i < problem.width_; ++i) {
+				output_board[j * 2 + 1][i * 2 + 1] = "　";
+			}
+		}
+		// セル間の罫線を、演算子に置き換える
+		for (size_t y = 0; y < problem.height_; ++y) {
+			for (size_t x = 0; x < problem.width_; ++x) {
+				size_t pos = y * problem.width_ + x;
+				const auto &dir_list = problem.field_[pos];
+				for (const auto &dir : dir_list) {
+					const auto &side = problem.side_[dir.side_index];
+					if (side.str() == "")
+						continue;
+					// 上
+					if (pos == dir.next_position + problem.width_) {
+						output_board[y * 2][x * 2 + 1] = side.str();
+					}
+					// 右
+					if (pos + 1 == dir.next_position) {
+						output_board[y * 2 + 1][x * 2 + 2] = side.str();
+					}
+					// 下
+					if (pos + problem.width_ == dir.next_position) {
+						output_board[y * 2 + 2][x * 2 + 1] = side.str();
+					}
+					// 左
+					if (pos == dir.next_position + 1) {
+						output_board[y * 2 + 1][x * 2] = side.str();
+					}
+				}
+			}
+		}
+		// スタート・ゴールマークを入力する
+		{
+			// スタートマーク
+			size_t sx = problem.start_ % problem.width_;
+			size_t sy = problem.start_ / problem.width_;
+			output_board[sy * 2 + 1][sx * 2 + 1] = "Ｓ";
+			// ゴールマーク
+			size_t gx = problem.goal_ % problem.width_;
+			size_t gy = problem.goal_ / problem.width_;
+			output_board[gy * 2 + 1][gx * 2 + 1] = "Ｇ";
+		}
+		// 途中経路を入力する
+		{
+			// 始点
+			size_t rp = problem.pre_root_[0];
+			size_t rx = rp % problem.width_;
+			size_t ry = rp / problem.width_;
+			if (output_board[ry * 2 + 1][rx * 2 + 1] == "　") {
+				output_board[ry * 2 + 1][rx * 2 + 1] = "○";
+			}
+			// 途中経路
+			size_t old_dir = 0;	//1から順に上・右・下・左であるものとする
+			for (size_t i = 1; i < problem.pre_root_.size(); ++i) {
+				// 上
+				if (rp == problem.pre_root_[i] + problem.width_) {
+					output_board[ry * 2][rx * 2 + 1] = "┃";
+					if (i > 1) {
+						switch (old_dir){
+						case 1:	//上上
+							output_board[ry * 2 + 1][rx * 2 + 1] = "┃";
+							break;
+						case 2:	//右上
+							output_board[ry * 2 + 1][rx * 2 + 1] = "┛";
+							break;
+						case 4:	//左上
+							output_board[ry * 2 + 1][rx * 2 + 1] = "┗";
+							break;
+						}
+					}
+					rp -= problem.width_;
+					ry--;
+					old_dir = 1;
+				}
+				// 右
+				if (rp + 1 == problem.pre_root_[i]) {
+					output_board[ry * 2 + 1][rx * 2 + 2] = "━";
+					if (i > 1) {
+						switch (old_dir) {
+						case 1:	//上右
+							output_board[ry * 2 + 1][rx * 2 + 1] = "┏";
+							break;
+						case 2:	//右右
+							output_board[ry * 2 + 1][rx * 2 + 1] = "━";
+							break;
+						case 3:	//下右
+							output_board[ry * 2 + 1][rx * 2 + 1] = "┗";
+							break;
+						}
+					}
+					rp += 1;
+					rx++;
+					old_dir = 2;
+				}
+				// 下
+				if (rp + problem.width_ == problem.pre_root_[i]) {
+					output_board[ry * 2 + 2][rx * 2 + 1] = "┃";
+					if (i > 1) {
+						switch (old_dir) {
+						case 2:	//右下
+							output_board[ry * 2 + 1][rx * 2 + 1] = "┓";
+							break;
+						case 3:	//下下
+							output_board[ry * 2 + 1][rx * 2 + 1] = "┃";
+							break;
+						case 4:	//左下
+							output_board[ry * 2 + 1][rx * 2 + 1] = "┏";
+							break;
+						}
+					}
+					rp += problem.width_;
+					ry++;
+					old_dir = 3;
+				}
+				// 左
+				if (rp == problem.pre_root_[i] + 1) {
+					output_board[ry * 2 + 1][rx * 2] = "━";
+					if (i > 1) {
+						switch (old_dir) {
+						case 1:	//上左
+							output_board[ry * 2 + 1][rx * 2 + 1] = "┓";
+							break;
+						case 3:	//下左
+							output_board[ry * 2 + 1][rx * 2 + 1] = "┛";
+							break;
+						case 4:	//左左
+							output_board[ry * 2 + 1][rx * 2 + 1] = "━";
+							break;
+						}
+					}
+					rp -= 1;
+					rx--;
+					old_dir = 4;
+				}
+			}
+		}
+		// 結果を文字列に変換する
+		for (const auto &line : output_board) {
+			for (const auto &str : line) {
+				os << str;
+			}
+			os << endl;
+		}
+		return os;
+	}
+};
+
+// 解答データ
+// 経路は「始点」と「各歩で上下左右のどちらに進んだか」で表し、
+// 後者は1歩あたり2bit(StepCode)にして64bit整数へ32歩分ずつ詰めて持つ
+// (ベストスコア更新時のコピーを軽くするため。頂点番号への復元は出力時に1回だけ行う)
+class Result {
+	vector<uint64_t> step_list_;
+	size_t step_count_ = 0;
+	size_t start_ = 0, width_ = 1;
+public:
+	// コンストラクタ
+	Result(){}
+	Result(const size_t side_size, const size_t width, const size_t start) {
+		reset(side_size, width, start);
+	}
+	// 途中までの経路をなぞった状態で初期化する
+	explicit Result(const Problem &problem) {
+		reset(problem);
+	}
+	// 確保済みの領域を使い回して初期化し直す
+	// (同じ辺は2回通れないので、歩数は辺の数を超えない)
+	void reset(const size_t side_size, const size_t width, const size_t start) {
+		step_list_.resize(side_size / 32 + 1);
+		step_count_ = 0;
+		start_ = start;
+		width_ = width;
+	}
+	void reset(const Problem &problem) {
+		const auto &pre_root = problem.get_pre_root();
+		reset(problem.side_size(), problem.get_width(), pre_root[0]);
+		for (size_t i = 1; i < pre_root.size(); ++i) {
+			move_side(get_step_code(pre_root[i - 1], pre_root[i], width_));
+		}
+	}
+	// 辺を移動した際の操作
+	void move_side(const unsigned int step) noexcept {
+		uint64_t &word = step_list_[step_count_ / 32];
+		const unsigned int shift = (step_count_ % 32) * 2;
+		word = (word & ~(uint64_t(3) << shift)) | (uint64_t(step) << shift);
+		++step_count_;
+	}
+	// 歩数
+	size_t size() const noexcept {
+		return step_count_;
+	}
+	// 辺を戻した際の操作
+	void back_side() noexcept {
+		--step_count_;
+	}
+	void back_side2() noexcept {
+		step_count_ -= 2;
+	}
+	// getter
+	// (頂点番号の列に復元する)
+	vector<size_t> get_root() const {
+		vector<size_t> root(step_count_ + 1);
+		root[0] = start_;
+		for (size_t i = 0; i < step_count_; ++i) {
+			const unsigned int step = (step_list_[i / 32] >> ((i % 32) * 2)) & 3;
+			root[i + 1] = move_position(root[i], step, width_);
+		}
+		return root;
+	}
+	// 出力用(等幅フォント用)
+	friend ostream& operator << (ostream& os, const Result& result) {
+		const auto root = result.get_root();
+		for (size_t i = 0; i < root.size(); ++i) {
+			if (i != 0)
+				os << "->";
+			os << root[i];
+		}
+		return os;
+	}
+};
+
+// 複数の解を保持するリスト(全スレッドで共有する)
+// ・上位K件モード：スコアの高い順にK件までを保持する
+// ・全最適解モード(K=0)：最高スコアに並ぶ解を全て保持する
+// 排他制御は呼び出し側(Solver)で行う
+class RouteList {
+	size_t max_size_;
+	// 上位K件モードでは、スコアが最も低い解を先頭に置くヒープとして扱う
+	vector<std::pair<int, Result>> list_;
+	static bool greater(const std::pair<int, Result> &a, const std::pair<int, Result> &b) noexcept {
+		return a.first > b.first;
+	}
+public:
+	// コンストラクタ
+	explicit RouteList(const size_t max_size) : max_size_(max_size) {}
+	// 全最適解モードか？
+	bool all_optimal_flg() const noexcept {
+		return max_size_ == 0;
+	}
+	// これ未満のスコアの解はもう追加されない、という下限を返す
+	// (ソルバーはこれをベストスコアの代わりに使って枝刈りする)
+	int threshold() const noexcept {
+		if (all_optimal_flg())
+			return (list_.empty() ? -9999 : list_.front().first);
+		return (list_.size() < max_size_ ? -9999 : list_.front().first);
+	}
+	// 解を追加する
+	void push(const Result &result, const int score) {
+		if (all_optimal_flg()) {
+			if (!list_.empty() && score < list_.front().first)
+				return;
+			if (!list_.empty() && score > list_.front().first)
+				list_.clear();
+			list_.emplace_back(score, result);
+			return;
+		}
+		if (list_.size() < max_size_) {
+			list_.emplace_back(score, result);
+			std::push_heap(list_.begin(), list_.end(), greater);
+		}
+		else if (score > list_.front().first) {
+			std::pop_heap(list_.begin(), list_.end(), greater);
+			list_.back() = std::pair<int, Result>(score, result);
+			std::push_heap(list_.begin(), list_.end(), greater);
+		}
+	}
+	// スコアの高い順に並べて返す
+	vector<std::pair<int, Result>> sorted() const {
+		auto list = list_;
+		std::stable_sort(list.begin(), list.end(), greater);
+		return list;
+	}
+};
+
+// 分割した部分問題
+// 元の問題の途中までの経路の後ろに、routeの地点を順に付け足したものを表す
+// (Problemを丸ごとコピーせずに、付け足した経路だけを持つ)
+struct SplitTask {
+	vector<size_t> route;
+	// routeを辿り終えた時点の得点
+	int score;
+	// 見込みスコア
+	int upper_score;
+};
+
+// 探索1回分(コマンドラインからの実行1回や、サーバーモードのリクエスト1件)の状態
+// 解くべき部分問題の一覧と、それを解く全ワーカースレッドで共有する情報を持つ
+// (サーバーモードでは複数の探索が同時に進むので、共有する情報はグローバル変数ではなくここに置く)
+struct SearchState {
+	// 元の問題
+	Problem problem;
+	// 部分問題の一覧
+	vector<SplitTask> split_list;
+	// スタート・ゴールの組み合わせの一覧(スタート・ゴールを自由に選ぶモードでのみ使う)
+	vector<std::pair<size_t, size_t>> pair_list;
+	// ポートフォリオモードの探索設定と、それに合わせて候補手を並べ替えた問題の一覧(ポートフォリオモードでのみ使う)
+	vector<PortfolioConfig> portfolio_list;
+	vector<Problem> portfolio_problem_list;
+	// (見込みスコア, 部分問題の番号)の組を、見込みスコアの高い順に並べたもの
+	vector<std::pair<int, size_t>> task_list;
+	// 次に取り出す部分問題の番号
+	std::atomic<size_t> next_task;
+	// 盤面全体での見込みスコア(これに達したら最適解が確定する)
+	int upper_score;
+	// 最適解が確定したので、全ての探索を打ち切るべきか？
+	std::atomic<bool> stop_flg;
+	// 探索ごとに振る通し番号(ワーカーが、前回と同じ探索かどうかを見分けるのに使う)
+	const uint64_t id;
+	// 残りの辺がこの本数以下になったら、終盤の探索に切り替える(0なら切り替えない)
+	// (既定では切り替えない。枝刈りが良く効くので、終盤の探索に切り替えても速くならなかった)
+	static const size_t default_endgame_size = 0;
+	size_t endgame_size = default_endgame_size;
+	// 見込みスコアを、奇偶の合わない地点で通らずに残す辺の分だけ下げるか？
+	// (既定では行わない。枝刈りは増えるが、補正を算出する手間の方が大きく、手元の盤面では遅くなった)
+	bool parity_flg = false;
+	// 複数の解を出力するモードの際の、解の格納先(それ以外では空)
+	std::unique_ptr<RouteList> route_list;
+	// 以下はmtxで排他制御する
+	// (ただしbest_scoreは枝刈りの判定で頻繁に読むので、読み取りだけはロックせずに行う)
+	std::mutex mtx;
+	int best_score = -9999;
+	// 部分問題ごとの最適解のうち、最も良いもの
+	std::pair<Result, int> best;
+	// 部分問題ごとに見つけた最も良い経路を、(スコア, 経路)の組でfound_listに残すか？
+	// (対話モードで、次の探索に引き継ぐのに使う)
+	bool keep_found_flg = false;
+	vector<std::pair<int, Result>> found_list;
+	// 実行中のワーカーの数
+	unsigned int running_count = 0;
+	// 全ての部分問題を解き終えたか？
+	bool finish_flg = false;
+	std::condition_variable finish_cv;
+	// 解き終えた際に呼ばれる処理(サーバーモードで結果を送り返すのに使う)
+	std::function<void(SearchState&)> on_finish;
+	// ベストスコアを更新するたびに呼ばれる処理(ライブラリの呼び出し元へ、途中で見つけた解を知らせるのに使う)
+	// (ワーカースレッドから、mtxをロックしたまま呼ばれる。複数の解を出力するモードでは呼ばれない)
+	std::function<void(const Result&, int)> on_improve;
+	// コンストラクタ
+	// top_countが0以外なら上位top_count件の解を、all_optimal_flgがtrueなら最高スコアに並ぶ全ての解を保持する
+	explicit SearchState(const Problem &src_problem, const size_t top_count = 0, const bool all_optimal_flg = false)
+		: problem(src_problem), next_task(0), upper_score(src_problem.get_upper_score()), stop_flg(false), id(get_next_id()), best(Result(src_problem), -9999) {
+		if (top_count != 0 || all_optimal_flg)
+			route_list.reset(new RouteList(top_count));
+	}
+	// 次の通し番号を返す
+	static uint64_t get_next_id() noexcept {
+		static std::atomic<uint64_t> next_id(1);
+		return next_id++;
+	}
+	// スタート・ゴールを自由に選ぶモードか？
+	bool free_flg() const noexcept {
+		return !pair_list.empty();
+	}
+	// ポートフォリオモードか？
+	bool portfolio_flg() const noexcept {
+		return !portfolio_list.empty();
+	}
+	// スタート・ゴールを自由に選ぶモードで、番号indexの組み合わせの問題を取得する(workはワーカーごとの作業領域)
+	const Problem& get_free_problem(const size_t index, Problem &work) const {
+		if (work.side_size() == 0)
+			work = problem;
+		work.set_start_goal(pair_list[index].first, pair_list[index].second);
+		return work;
+	}
+	// 全ての部分問題を解き終えるまで待つ
+	void wait() {
+		std::unique_lock<std::mutex> lock(mtx);
+		finish_cv.wait(lock, [this] { return finish_flg; });
+	}
+	// 全ての部分問題を解き終えるまで、最大でtimeoutだけ待つ(解き終えていればtrueを返す)
+	template<class Rep, class Period>
+	bool wait_for(const std::chrono::duration<Rep, Period> &timeout) {
+		std::unique_lock<std::mutex> lock(mtx);
+		return finish_cv.wait_for(lock, timeout, [this] { return finish_flg; });
+	}
+	// 出力する解を、スコアの高い順に並べて返す
+	vector<std::pair<int, Result>> get_output_list() const {
+		if (route_list)
+			return route_list->sorted();
+		return vector<std::pair<int, Result>>(1, std::pair<int, Result>(best.second, best.first));
+	}
+};
+
+// 呼び出したワーカースレッドを、まだ割り当てていないCPUコアに固定する(スレッドごとに最初の1回だけ)
+inline void pin_worker_thread() noexcept {
+	static std::atomic<unsigned int> next_core(0);
+	static thread_local bool pinned_flg = false;
+	if (pinned_flg)
+		return;
+	pin_thread(next_core++);
+	pinned_flg = true;
+}
+
+// 並列探索の動きの記録(トレース)
+// ワーカーごとの出来事(部分問題の取り出し・開始・終了、ベストスコアの更新、キューでの待ち)を時刻付きで記録し、
+// Chrome trace-event形式のJSON(chrome://tracingやPerfettoで表示できる)として書き出す
+// ・記録はスレッドごとのリングバッファに書くだけなので、ロックしない
+//   (バッファを作る最初の1回だけロックする。一杯になったら古いものから上書きし、終盤の記録を残す)
+// ・記録しない場合は、g_tracerがnullptrかどうかを調べるだけになる
+class Tracer {
+	// 出来事1つ分
+	struct Event {
+		// 名前(文字列リテラルを指す)
+		const char *name;
+		// 種類('X'なら期間、'i'なら瞬間)
+		char phase;
+		// 開始・終了時刻(記録開始からのナノ秒。瞬間の場合は同じ値)
+		int64_t begin, end;
+		// スコア等の数値
+		int64_t value;
+		// 部分問題を解いた記録なら、その探索の通し番号(それ以外は0)と、部分問題の(順位, 番号)
+		// (補足の文字列は、記録を軽くするためにwrite()で作る)
+		uint64_t search_id;
+		size_t task_rank, task_index;
+	};
+	// スレッド1つ分のリングバッファ
+	struct Buffer {
+		unsigned int thread_id;
+		// 記録するスレッド
+		std::thread::id owner;
+		vector<Event> event_list;
+		// これまでに記録した数(event_list.size()を超えた分は上書きされている)
+		size_t count = 0;
+	};
+	// 1スレッドあたりの記録数の上限
+	static const size_t capacity = 1 << 16;
+	// Tracerごとに振る通し番号(スレッドごとに覚えたバッファが、どのTracerのものかを見分けるのに使う)
+	const uint64_t id_;
+	std::chrono::steady_clock::time_point start_time_;
+	std::mutex mtx_;
+	vector<std::unique_ptr<Buffer>> buffer_list_;
+	// 部分問題の説明に使う情報(探索の通し番号ごとに、keep()の時点で写しておく)
+	// (探索そのものを保持すると、サーバーモードで接続等まで残ってしまうので、必要な分だけ写す)
+	struct TaskTable {
+		vector<std::pair<size_t, size_t>> pair_list;
+		vector<string> portfolio_list;
+		vector<SplitTask> split_list;
+	};
+	std::map<uint64_t, TaskTable> table_list_;
+	static uint64_t get_next_id() noexcept {
+		static std::atomic<uint64_t> next_id(1);
+		return next_id++;
+	}
+	// 呼び出したスレッドのバッファを返す(Tracerごとに、最初の1回だけ作る)
+	// (スレッドごとに覚えるのは直前に使ったTracerの分だけなので、別のTracerに切り替わったら、そのTracerの中から探し直す)
+	Buffer& get_buffer() {
+		static thread_local uint64_t tracer_id = 0;
+		static thread_local Buffer *buffer = nullptr;
+		if (tracer_id != id_) {
+			const auto owner = std::this_thread::get_id();
+			std::lock_guard<std::mutex> lock(mtx_);
+			const auto it = std::find_if(buffer_list_.begin(), buffer_list_.end(),
+				[&owner](const std::unique_ptr<Buffer> &b) { return b->owner == owner; });
+			if (it != buffer_list_.end()) {
+				buffer = it->get();
+			}
+			else {
+				buffer_list_.emplace_back(new Buffer());
+				buffer = buffer_list_.back().get();
+				buffer->thread_id = static_cast<unsigned int>(buffer_list_.size());
+				buffer->owner = owner;
+				buffer->event_list.resize(capacity);
+			}
+			tracer_id = id_;
+		}
+		return *buffer;
+	}
+	Event& record(const char *name, const char phase, const int64_t begin, const int64_t end, const int64_t value) {
+		Buffer &buffer = get_buffer();
+		Event &event = buffer.event_list[buffer.count % capacity];
+		event.name = name;
+		event.phase = phase;
+		event.begin = begin;
+		event.end = end;
+		event.value = value;
+		event.search_id = 0;
+		++buffer.count;
+		return event;
+	}
+	// 部分問題の説明
+	static string get_task_detail(const TaskTable &table, const size_t rank, const size_t index) {
+		std::ostringstream oss;
+		oss << "#" << rank << " ";
+		if (!table.pair_list.empty()) {
+			oss << table.pair_list[index].first << "->" << table.pair_list[index].second;
+		}
+		else if (!table.portfolio_list.empty()) {
+			oss << table.portfolio_list[index];
+		}
+		else {
+			oss << "upper=" << table.split_list[index].upper_score << " route=";
+			for (size_t i = 0; i < table.split_list[index].route.size(); ++i) {
+				oss << (i != 0 ? "->" : "") << table.split_list[index].route[i];
+			}
+		}
+		return oss.str();
+	}
+	// JSONの文字列として書き出す(補足には英数字と記号しか入らないが、念のため「"」と「\」だけ逃がす)
+	static void write_string(ostream &os, const string &str) {
+		os << '"';
+		for (const char c : str) {
+			if (c == '"' || c == '\\')
+				os << '\\';
+			os << c;
+		}
+		os << '"';
+	}
+public:
+	// コンストラクタ
+	Tracer() : id_(get_next_id()), start_time_(std::chrono::steady_clock::now()) {}
+	Tracer(const Tracer&) = delete;
+	Tracer& operator=(const Tracer&) = delete;
+	// 記録開始からの時刻(ナノ秒)
+	int64_t now() const noexcept {
+		return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start_time_).count();
+	}
+	// beginから今までの期間を記録する
+	void complete(const char *name, const int64_t begin, const int64_t value = 0) {
+		record(name, 'X', begin, now(), value);
+	}
+	// beginから今までの期間を、stateの部分問題(見込みスコアの高い順でrank番目、番号index)を解いた記録とする
+	// (stateは、keep()で渡したものであること)
+	void complete_task(const char *name, const int64_t begin, const int64_t value, const SearchState &state, const size_t rank, const size_t index) {
+		Event &event = record(name, 'X', begin, now(), value);
+		event.search_id = state.id;
+		event.task_rank = rank;
+		event.task_index = index;
+	}
+	// 今の瞬間を記録する
+	void instant(const char *name, const int64_t value = 0) {
+		const int64_t time = now();
+		record(name, 'i', time, time, value);
+	}
+	// 部分問題を記録する探索の、部分問題の説明に使う情報を写しておく(探索1回につき、始める際に1回だけ呼ぶ)
+	void keep(const SearchState &state) {
+		TaskTable table;
+		table.pair_list = state.pair_list;
+		for (const auto &config : state.portfolio_list) {
+			table.portfolio_list.push_back(config.str());
+		}
+		if (!state.free_flg() && !state.portfolio_flg())
+			table.split_list = state.split_list;
+		std::lock_guard<std::mutex> lock(mtx_);
+		table_list_.emplace(state.id, std::move(table));
+	}
+	// 記録をファイルに書き出す(全てのワーカーが止まってから呼ぶこと)
+	void write(const string &file_name) {
+		std::ofstream ofs(file_name);
+		if (ofs.fail())
+			throw "トレースファイルに書き込めません。";
+		std::lock_guard<std::mutex> lock(mtx_);
+		ofs << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[" << endl;
+		bool first_flg = true;
+		for (const auto &buffer : buffer_list_) {
+			ofs << (first_flg ? "" : ",\n") << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << buffer->thread_id
+				<< ",\"args\":{\"name\":\"thread " << buffer->thread_id << "\"}}";
+			first_flg = false;
+			// (capacityは定義を持たない定数なので、参照で受けるstd::minには渡さない)
+			const size_t size = (buffer->count < capacity ? buffer->count : capacity);
+			for (size_t i = buffer->count - size; i < buffer->count; ++i) {
+				const Event &event = buffer->event_list[i % capacity];
+				// (時刻はマイクロ秒で書く)
+				ofs << ",\n{\"name\":\"" << event.name << "\",\"ph\":\"" << event.phase << "\",\"pid\":1,\"tid\":" << buffer->thread_id
+					<< ",\"ts\":" << event.begin / 1000 << "." << std::setw(3) << std::setfill('0') << event.begin % 1000 << std::setfill(' ');
+				if (event.phase == 'X')
+					ofs << ",\"dur\":" << (event.end - event.begin) / 1000 << "." << std::setw(3) << std::setfill('0') << (event.end - event.begin) % 1000 << std::setfill(' ');
+				else
+					ofs << ",\"s\":\"t\"";
+				ofs << ",\"args\":{\"value\":" << event.value;
+				const auto table = table_list_.find(event.search_id);
+				if (event.search_id != 0 && table != table_list_.end()) {
+					ofs << ",\"detail\":";
+					write_string(ofs, get_task_detail(table->second, event.task_rank, event.task_index));
+				}
+				ofs << "}}";
+			}
+		}
+		ofs << endl << "]}" << endl;
+	}
+};
+// トレースの記録先(nullptrなら記録しない)
+extern Tracer *g_tracer;
+
+// 終盤の探索(メモ化した動的計画法)
+// 残りの辺が少ない局面では、辺を通る順番だけが違う経路から、同じ局面が何度も現れる。そこで
+// (今いる地点, まだ通れる辺の集合)ごとに、ゴールまでの経路の演算(×M＋A)の一覧をまとめて求めてメモ化し、使い回す。
+// ・経路ごとに演算は違うが、Mが同じならAが最大のものだけ残せば良い(今の得点によらず、そちらの方が良い)
+// ・メモはハッシュ表で、衝突したら上書きする。キーの辺の集合は辺の番号の列で持ち、一致を確かめる
+// ・辺の集合がmax_edges本より大きい場合や、演算がmax_lines個より多くなる場合は、通常の探索に任せる
+class EndgameTable {
+public:
+	// 辺の集合の大きさの上限
+	static const size_t max_edges = 24;
+	// 1つの局面で持つ演算の数の上限
+	static const size_t max_lines = 4;
+	// 演算(×mul_num＋add_num)
+	struct Line {
+		int mul_num, add_num;
+	};
+	// ハッシュ表の1要素
+	struct Slot {
+		uint64_t hash;
+		// 書き込んだ際の世代(0なら空き)
+		uint32_t generation;
+		uint16_t position;
+		// 辺の数・演算の数(演算が多すぎて諦めた局面では、演算の数をmax_lines+1とする)
+		unsigned char edge_count, line_count;
+		uint16_t edge_list[max_edges];
+		Line line_list[max_lines];
+	};
+private:
+	// ハッシュ表の大きさ(2のべき乗)
+	static const size_t table_size = 1 << 16;
+	vector<Slot> slot_list_;
+	// 今の世代(問題が変わったら増やし、それ以前に書き込んだものを無効にする)
+	uint32_t generation_ = 0;
+	const Problem *problem_ = nullptr;
+	// 辺の番号ごとの乱数(辺の集合のハッシュ値は、含まれる辺の乱数のXORとする)
+	vector<uint64_t> zobrist_list_;
+	// 今の局面で集めた辺(辺の番号の昇順)と、辺の番号からその中での順番への対応(集めていない辺は-1)
+	vector<uint16_t> edge_list_;
+	vector<int> local_index_;
+	// 辺の集合maskを、辺の番号の列にする
+	size_t get_edge_list(const uint32_t mask, uint16_t *edge_list) const noexcept {
+		size_t count = 0;
+		for (uint32_t m = mask; m != 0; m &= m - 1) {
+			edge_list[count++] = edge_list_[bit_scan_forward(m)];
+		}
+		return count;
+	}
+public:
+	// 問題problemを解き始める際に呼ぶ(new_problem_flgがtrueなら、これまでのメモを捨てる)
+	void reset(const Problem &problem, const bool new_problem_flg) {
+		problem_ = &problem;
+		if (slot_list_.empty())
+			slot_list_.resize(table_size);
+		if (new_problem_flg && ++generation_ == 0) {
+			// (世代が一周したら、表を空にし直す)
+			for (auto &slot : slot_list_) {
+				slot.generation = 0;
+			}
+			generation_ = 1;
+		}
+		if (zobrist_list_.size() < problem.side_size()) {
+			std::mt19937_64 rand(zobrist_list_.size());
+			while (zobrist_list_.size() < problem.side_size()) {
+				zobrist_list_.push_back(rand());
+			}
+		}
+		edge_list_.clear();
+		local_index_.assign(problem.side_size(), -1);
+	}
+	// 未使用の辺を集め、辺の集合のハッシュ値をhashに入れる
+	// (max_edges本を超えたらfalseを返す。今いる地点から辿れない辺も含めるが、
+	//   辿れるものだけに絞るよりも、集める手間が減る分の方が大きかった)
+	bool collect(const vector<int> &side_flg, uint64_t &hash) {
+		for (const auto side_index : edge_list_) {
+			local_index_[side_index] = -1;
+		}
+		edge_list_.clear();
+		hash = 0;
+		for (size_t i = 0; i < side_flg.size(); ++i) {
+			if (!side_flg[i])
+				continue;
+			if (edge_list_.size() >= max_edges)
+				return false;
+			local_index_[i] = static_cast<int>(edge_list_.size());
+			edge_list_.push_back(static_cast<uint16_t>(i));
+			hash ^= zobrist_list_[i];
+		}
+		return true;
+	}
+	// collectで集めた辺の数
+	size_t edge_count() const noexcept {
+		return edge_list_.size();
+	}
+	// 地点positionから、辺の集合mask(collectで集めた辺の順番のビット)の辺だけを使ってゴールへ行く経路の演算の一覧を求める
+	// (hashはmaskのハッシュ値。演算が多すぎて諦めた場合はnullptrを返す。
+	//   返した一覧は、次にsolveを呼ぶと書き換わることがある)
+	const Slot* solve(const size_t position, const uint32_t mask, const uint64_t hash) {
+		const uint64_t key = hash ^ (position * 0x9E3779B97F4A7C15ULL);
+		Slot &slot = slot_list_[(key ^ (key >> 29)) & (table_size - 1)];
+		uint16_t edge_list[max_edges];
+		const size_t edge_count = get_edge_list(mask, edge_list);
+		if (slot.generation == generation_ && slot.hash == key && slot.position == position && slot.edge_count == edge_count
+			&& std::equal(edge_list, edge_list + edge_count, slot.edge_list))
+			return (slot.line_count <= max_lines ? &slot : nullptr);
+		// ゴールで止まる経路と、1歩進んだ先からの経路を合わせる
+		Line line_list[max_lines];
+		size_t line_count = 0;
+		bool ok_flg = true;
+		const auto add_line = [&](const int mul_num, const int add_num) {
+			for (size_t i = 0; i < line_count; ++i) {
+				if (line_list[i].mul_num == mul_num) {
+					line_list[i].add_num = std::max(line_list[i].add_num, add_num);
+					return;
+				}
+			}
+			if (line_count >= max_lines)
+				ok_flg = false;
+			else
+				line_list[line_count++] = Line{ mul_num, add_num };
+		};
+		if (position == problem_->get_goal())
+			add_line(1, 0);
+		for (const auto &dir : problem_->get_dir_list1(position)) {
+			const int local_index = local_index_[dir.side_index];
+			if (local_index < 0 || !((mask >> local_index) & 1))
+				continue;
+			const Slot *next = solve(dir.next_position, mask & ~(1u << local_index), hash ^ zobrist_list_[dir.side_index]);
+			if (next == nullptr) {
+				ok_flg = false;
+				break;
+			}
+			// (1歩目の演算の後に、行き先からの演算を行う)
+			for (size_t i = 0; i < next->line_count && ok_flg; ++i) {
+				add_line(dir.mul_num * next->line_list[i].mul_num, dir.add_num * next->line_list[i].mul_num + next->line_list[i].add_num);
+			}
+			if (!ok_flg)
+				break;
+		}
+		// (子の局面を求める間に同じ要素が上書きされていることがあるので、キーも書き直す)
+		slot.hash = key;
+		slot.generation = generation_;
+		slot.position = static_cast<uint16_t>(position);
+		slot.edge_count = static_cast<unsigned char>(edge_count);
+		std::copy(edge_list, edge_list + edge_count, slot.edge_list);
+		slot.line_count = static_cast<unsigned char>(ok_flg ? line_count : max_lines + 1);
+		std::copy(line_list, line_list + line_count, slot.line_list);
+		return (ok_flg ? &slot : nullptr);
+	}
+	// 地点positionから、辺の集合maskの辺だけを使ってゴールへ行き、演算lineになる経路の1歩目を探す
+	// (見つかれば、その方向データと行き先での演算をdir・next_lineに入れてtrueを返す)
+	bool find_step(const size_t position, const uint32_t mask, const uint64_t hash, const Line &line, const Move1 *&dir, Line &next_line) {
+		for (const auto &candidate : problem_->get_dir_list1(position)) {
+			const int local_index = local_index_[candidate.side_index];
+			if (local_index < 0 || !((mask >> local_index) & 1))
+				continue;
+			const Slot *next = solve(candidate.next_position, mask & ~(1u << local_index), hash ^ zobrist_list_[candidate.side_index]);
+			if (next == nullptr)
+				continue;
+			for (size_t i = 0; i < next->line_count; ++i) {
+				if (candidate.mul_num * next->line_list[i].mul_num == line.mul_num
+					&& candidate.add_num * next->line_list[i].mul_num + next->line_list[i].add_num == line.add_num) {
+					dir = &candidate;
+					next_line = next->line_list[i];
+					return true;
+				}
+			}
+		}
+		return false;
+	}
+	// 辺の番号sideの、collectで集めた辺の中での順番(集めていなければ-1)
+	int get_local_index(const size_t side_index) const noexcept {
+		return local_index_[side_index];
+	}
+	uint64_t get_zobrist(const size_t side_index) const noexcept {
+		return zobrist_list_[side_index];
+	}
+};
+
+// ソルバー
+class Solver {
+	// 探索中の問題(呼び出し元が保持しているものを参照する)
+	const Problem *problem_ = nullptr;
+	// 探索全体で共有する情報
+	SearchState *state_ = nullptr;
+	Result result_, best_result_;
+	int score_, best_score_;
+	// (候補手の一括評価でgatherできるよう、int型で持つ)
+	vector<int> side_flg_;
+	vector<int> available_side_count_;
+	int max_mul_value_, max_add_value_;
+	// 見込みスコアを奇偶で補正するか？(探索ごとにstate_->parity_flgに合わせる)
+	bool parity_flg_ = false;
+	// まだ通れる辺の数が奇数の地点について、そこで通らずに残す辺の得点(bound_add_num)の最小値
+	// (偶数の地点や、補正しない場合は0。parity_cost_sum_はその合計で、見込みスコアの補正に使う)
+	vector<int> parity_cost_;
+	int parity_cost_sum_;
+	// 複数の解を出力するモードの際の、解の格納先(それ以外ではnullptr)
+	RouteList *route_list_ = nullptr;
+	// 終盤の探索のメモと、それに切り替える歩数(切り替えない場合は最大値)
+	EndgameTable endgame_;
+	size_t endgame_depth_ = std::numeric_limits<size_t>::max();
+	// 終盤の探索のメモを作った探索の通し番号と、そのゴール地点(これが変わったらメモを捨てる)
+	uint64_t endgame_state_id_ = 0;
+	size_t endgame_goal_ = 0;
+
+	// 2歩分の候補手をまとめて評価し、展開すべき候補をビットマスクで返す
+	// ・2辺とも未使用で、かつ行き先にまだ通れる辺が残っているか
+	// ・移動後の見込みスコアが、現時点のベストスコアを下回らないか
+	// を全候補について一度に判定する。見込みスコアは移動先で改めて厳密に判定するため、
+	// ここでは除算を避けた緩い上限(Xを移動後の得点+残りの加算分として、X<0ならX、そうでなければX*max_mul_value_)を使う
+	unsigned int filter_dir_list2(const Direction2List &dir_list) const noexcept {
+		const unsigned int size_mask = (1u << dir_list.size) - 1;
+#if defined(CHALLERUN_AVX2)
+		// (1グループ=8レーンを、そのまま1本のレジスタで評価する)
+		const int best_score = state_->best_score;
+		const __m256i zero = _mm256_setzero_si256();
+		const __m256i one = _mm256_set1_epi32(1);
+		const __m256i score = _mm256_set1_epi32(score_);
+		const __m256i max_mul = _mm256_set1_epi32(max_mul_value_);
+		const __m256i max_add = _mm256_set1_epi32(max_add_value_);
+		const __m256i best = _mm256_set1_epi32(best_score);
+		unsigned int mask = 0;
+		for (size_t i = 0; i < dir_list.size; i += Move2Group::lanes) {
+			const Move2Group &dir = dir_list.first[i / Move2Group::lanes];
+			// (添字は16bitで持っているので、32bitに広げてからgatherする。使わないレーンは添字0を指している)
+			const __m256i side_index1 = _mm256_cvtepu16_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i*>(dir.side_index1)));
+			const __m256i side_index2 = _mm256_cvtepu16_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i*>(dir.side_index2)));
+			const __m256i next_position2 = _mm256_cvtepu16_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i*>(dir.next_position2)));
+			const __m256i flg1 = _mm256_i32gather_epi32(side_flg_.data(), side_index1, 4);
+			const __m256i flg2 = _mm256_i32gather_epi32(side_flg_.data(), side_index2, 4);
+			const __m256i count = _mm256_i32gather_epi32(available_side_count_.data(), next_position2, 4);
+			__m256i ok = _mm256_andnot_si256(_mm256_cmpeq_epi32(flg1, zero), _mm256_cmpgt_epi32(count, one));
+			ok = _mm256_andnot_si256(_mm256_cmpeq_epi32(flg2, zero), ok);
+			// 見込みスコア
+			const __m256i mul_num = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(dir.mul_num));
+			const __m256i add_num = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(dir.add_num));
+			const __m256i bound_add_num = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(dir.bound_add_num));
+			const __m256i next_score = _mm256_add_epi32(_mm256_mullo_epi32(score, mul_num), add_num);
+			const __m256i x = _mm256_add_epi32(next_score, _mm256_sub_epi32(max_add, bound_add_num));
+			const __m256i bound = _mm256_blendv_epi8(_mm256_mullo_epi32(x, max_mul), x, _mm256_srai_epi32(x, 31));
+			ok = _mm256_andnot_si256(_mm256_cmpgt_epi32(best, bound), ok);
+			mask |= static_cast<unsigned int>(_mm256_movemask_ps(_mm256_castsi256_ps(ok))) << i;
+		}
+		return mask & size_mask;
+#elif defined(CHALLERUN_SSE2)
+		// SSE2には32bit同士の乗算(下位32bit)が無いので、偶数・奇数レーンに分けて計算する
+		struct Local {
+			static __m128i mullo_epi32(const __m128i a, const __m128i b) noexcept {
+				const __m128i even = _mm_mul_epu32(a, b);
+				const __m128i odd = _mm_mul_epu32(_mm_srli_epi64(a, 32), _mm_srli_epi64(b, 32));
+				return _mm_unpacklo_epi32(_mm_shuffle_epi32(even, _MM_SHUFFLE(0, 0, 2, 0)), _mm_shuffle_epi32(odd, _MM_SHUFFLE(0, 0, 2, 0)));
+			}
+		};
+		const int best_score = state_->best_score;
+		const __m128i zero = _mm_setzero_si128();
+		const __m128i one = _mm_set1_epi32(1);
+		const __m128i score = _mm_set1_epi32(score_);
+		const __m128i max_mul = _mm_set1_epi32(max_mul_value_);
+		const __m128i max_add = _mm_set1_epi32(max_add_value_);
+		const __m128i best = _mm_set1_epi32(best_score);
+		unsigned int mask = 0;
+		for (size_t i = 0; i < dir_list.size; i += 4) {
+			// (1グループの前半・後半の4レーンずつ評価する)
+			const Move2Group &dir = dir_list.first[i / Move2Group::lanes];
+			const size_t k = i % Move2Group::lanes;
+			// SSE2にはgatherが無いので、フラグ類は一旦並べ直してから読み込む
+			alignas(16) int flg1[4], flg2[4], count[4];
+			for (size_t j = 0; j < 4; ++j) {
+				flg1[j] = side_flg_[dir.side_index1[k + j]];
+				flg2[j] = side_flg_[dir.side_index2[k + j]];
+				count[j] = available_side_count_[dir.next_position2[k + j]];
+			}
+			__m128i ok = _mm_andnot_si128(_mm_cmpeq_epi32(_mm_load_si128(reinterpret_cast<const __m128i*>(flg1)), zero),
+				_mm_cmpgt_epi32(_mm_load_si128(reinterpret_cast<const __m128i*>(count)), one));
+			ok = _mm_andnot_si128(_mm_cmpeq_epi32(_mm_load_si128(reinterpret_cast<const __m128i*>(flg2)), zero), ok);
+			// 見込みスコア
+			const __m128i mul_num = _mm_loadu_si128(reinterpret_cast<const __m128i*>(dir.mul_num + k));
+			const __m128i add_num = _mm_loadu_si128(reinterpret_cast<const __m128i*>(dir.add_num + k));
+			const __m128i bound_add_num = _mm_loadu_si128(reinterpret_cast<const __m128i*>(dir.bound_add_num + k));
+			const __m128i next_score = _mm_add_epi32(Local::mullo_epi32(score, mul_num), add_num);
+			const __m128i x = _mm_add_epi32(next_score, _mm_sub_epi32(max_add, bound_add_num));
+			const __m128i negative = _mm_srai_epi32(x, 31);
+			const __m128i bound = _mm_or_si128(_mm_and_si128(negative, x), _mm_andnot_si128(negative, Local::mullo_epi32(x, max_mul)));
+			ok = _mm_andnot_si128(_mm_cmpgt_epi32(best, bound), ok);
+			mask |= static_cast<unsigned int>(_mm_movemask_ps(_mm_castsi128_ps(ok))) << i;
+		}
+		return mask & size_mask;
+#else
+		// スカラー版では、見込みスコアは移動先での判定に任せる(こちらの方が速かった)
+		unsigned int mask = 0;
+		for (size_t i = 0; i < dir_list.size; ++i) {
+			const Move2 &dir = dir_list[i];
+			if (!side_flg_[dir.side_index1] || !side_flg_[dir.side_index2])
+				continue;
+			if (available_side_count_[dir.next_position2] <= 1)
+				continue;
+			mask |= 1u << i;
+		}
+		return mask & size_mask;
+#endif
+	}
+	// 今の状態から獲得可能な得点の上限(見込みスコア)
+	// 今の得点に残りの加算分を全て足した値をXとすると、X<0なら掛け算しない方が良いのでX、そうでなければX*max_mul_value_になる
+	// (Xが負の場合にX*max_mul_value_を使うと、上限を低く見積もり過ぎて最適解を枝刈りしてしまう)
+	// また、経路で使う辺の数は、今いる地点とゴールでは奇数、それ以外の地点では偶数になる。
+	// そのため、まだ通れる辺の数がそれと奇偶の合わない地点(以下「奇偶の合わない地点」)では、少なくとも1本の辺を通らずに残すことになる。
+	// 残す1本で両端の2地点分を賄えることもあるので、各地点で残す辺の得点の最小値を合計し、その半分(切り上げ)をXから引く
+	// (available_side_count_はゴールだけ+1してあるので、今いる地点以外は「奇数なら奇偶が合わない」で判定できる)
+	int get_upper_score(const size_t now_position) const noexcept {
+		return get_upper_score_with((parity_cost_sum_ - parity_cost_[now_position] + 1) / 2);
+	}
+	int get_upper_score_with(const int parity_reduction) const noexcept {
+		const int x = score_ + max_add_value_ - parity_reduction;
+		return (x < 0 ? x : x * max_mul_value_);
+	}
+	// 見込みスコアがthreshold未満か？
+	// get_upper_score()で判定できなければ、半分にせず引いた場合(これより良い補正は無い)でも判定できるかを調べ、
+	// 判定できそうな場合だけ、calc_parity_reduction()で補正し直す
+	bool is_hopeless(const size_t now_position, const int threshold) const noexcept {
+		if (!parity_flg_)
+			return (get_upper_score_with(0) < threshold);
+		const int parity_cost = parity_cost_sum_ - parity_cost_[now_position];
+		if (get_upper_score_with((parity_cost + 1) / 2) < threshold)
+			return true;
+		if (get_upper_score_with(parity_cost) >= threshold)
+			return false;
+		return (get_upper_score_with(calc_parity_reduction(now_position)) < threshold);
+	}
+	// 奇偶の合わない地点か？
+	bool is_parity_defect(const size_t position, const size_t now_position) const noexcept {
+		return ((available_side_count_[position] % 2 != 0) != (position == now_position));
+	}
+	// 奇偶による補正値を、残す辺の相手側まで見て算出し直す
+	// (残す辺の相手側も奇偶の合わない地点なら、その辺の得点は両端で半分ずつ数え、そうでなければ片側で全て数える)
+	int calc_parity_reduction(const size_t now_position) const noexcept {
+		// (半分ずつ数えるので、2倍した値で合計する)
+		int cost_sum = 0;
+		for (size_t p = 0; p < available_side_count_.size(); ++p) {
+			if (!is_parity_defect(p, now_position))
+				continue;
+			int cost = std::numeric_limits<int>::max();
+			for (const auto &dir : problem_->get_dir_list1(p)) {
+				if (side_flg_[dir.side_index])
+					cost = std::min(cost, dir.bound_add_num * (is_parity_defect(dir.next_position, now_position) ? 1 : 2));
+			}
+			if (cost != std::numeric_limits<int>::max())
+				cost_sum += cost;
+		}
+		return (cost_sum + 1) / 2;
+	}
+	// ある地点のparity_cost_を算出する
+	int calc_parity_cost(const size_t position) const noexcept {
+		if (available_side_count_[position] % 2 == 0)
+			return 0;
+		int cost = std::numeric_limits<int>::max();
+		for (const auto &dir : problem_->get_dir_list1(position)) {
+			if (side_flg_[dir.side_index])
+				cost = std::min(cost, dir.bound_add_num);
+		}
+		return (cost == std::numeric_limits<int>::max() ? 0 : cost);
+	}
+	// ある地点のparity_cost_を設定し、元の値を返す
+	// (探索関数では、今いる地点から出る直前に設定し、戻る際に元の値へ戻す。
+	//   それ以外の地点は、辺が減って最小値が大きくなっても古い値のままだが、それでも上限としては正しい)
+	int update_parity_cost(const size_t position) noexcept {
+		if (!parity_flg_)
+			return 0;
+		const int old_cost = parity_cost_[position];
+		const int cost = calc_parity_cost(position);
+		set_parity_cost(position, cost);
+		return old_cost;
+	}
+	void restore_parity_cost(const size_t position, const int old_cost) noexcept {
+		if (parity_flg_)
+			set_parity_cost(position, old_cost);
+	}
+	void set_parity_cost(const size_t position, const int cost) noexcept {
+		parity_cost_sum_ += cost - parity_cost_[position];
+		parity_cost_[position] = cost;
+	}
+	// ゴールに着いた際、今の解を記録すべきか？
+	bool is_record_candidate() const noexcept {
+		return (score_ > best_score_ || (route_list_ != nullptr && score_ >= state_->best_score));
+	}
+	// 見つけた解を記録し、全スレッドで共有するベストスコアを更新する
+	// (複数の解を出力するモードでは、ベストスコアの代わりにRouteList::threshold()を共有する)
+	void update_best_score() {
+		if (score_ > best_score_) {
+			best_result_ = result_;
+			best_score_ = score_;
+		}
+		std::lock_guard<std::mutex> lock(state_->mtx);
+		if (route_list_ != nullptr) {
+			route_list_->push(result_, score_);
+			state_->best_score = route_list_->threshold();
+		}
+		else if (state_->best_score < best_score_) {
+			state_->best_score = best_score_;
+			if (g_tracer != nullptr)
+				g_tracer->instant("incumbent", best_score_);
+			if (state_->on_improve)
+				state_->on_improve(best_result_, best_score_);
+		}
+		// (全最適解モードでは、最高スコアに並ぶ解を探し続ける必要があるので打ち切らない)
+		if (state_->best_score >= state_->upper_score && (route_list_ == nullptr || !route_list_->all_optimal_flg()))
+			state_->stop_flg = true;
+	}
+	// 終盤の探索
+	// 残りの辺が少なければ、EndgameTableで解いてtrueを返す(そうでなければ通常の探索に任せる)
+	// ゴールへの経路の演算のうち、今の得点から最も良くなるものを選び、記録すべきなら経路を復元して記録する
+	bool solve_endgame(const size_t now_position) {
+		uint64_t hash;
+		if (!endgame_.collect(side_flg_, hash))
+			return false;
+		const uint32_t mask = (1u << endgame_.edge_count()) - 1;
+		const auto *slot = endgame_.solve(now_position, mask, hash);
+		if (slot == nullptr)
+			return false;
+		if (slot->line_count == 0)
+			return true;
+		EndgameTable::Line line = slot->line_list[0];
+		for (size_t i = 1; i < slot->line_count; ++i) {
+			if (score_ * slot->line_list[i].mul_num + slot->line_list[i].add_num > score_ * line.mul_num + line.add_num)
+				line = slot->line_list[i];
+		}
+		const int old_score = score_;
+		score_ = score_ * line.mul_num + line.add_num;
+		if (!is_record_candidate()) {
+			score_ = old_score;
+			return true;
+		}
+		// 演算が一致する1歩目を順に探して、経路を復元する
+		// (ゴールで演算が「×1＋0」になったら、そこで止まる経路とする)
+		size_t position = now_position, step_count = 0;
+		uint32_t rest_mask = mask;
+		uint64_t rest_hash = hash;
+		bool ok_flg = true;
+		while (position != problem_->get_goal() || line.mul_num != 1 || line.add_num != 0) {
+			const Move1 *dir;
+			EndgameTable::Line next_line;
+			if (!endgame_.find_step(position, rest_mask, rest_hash, line, dir, next_line)) {
+				ok_flg = false;
+				break;
+			}
+			result_.move_side(dir->step);
+			++step_count;
+			rest_mask &= ~(1u << endgame_.get_local_index(dir->side_index));
+			rest_hash ^= endgame_.get_zobrist(dir->side_index);
+			position = dir->next_position;
+			line = next_line;
+		}
+		if (ok_flg)
+			update_best_score();
+		for (; step_count > 0; --step_count) {
+			result_.back_side();
+		}
+		score_ = old_score;
+		return ok_flg;
+	}
+	// 探索の準備として、問題の初期状態を読み込み、今いる地点を返す
+	size_t load(const Problem &problem) {
+		problem_ = &problem;
+		// 探索の起点となる解(途中までの経路を含む)
+		result_.reset(problem);
+		score_ = problem.get_pre_score();
+		// ある辺を踏破したか？
+		problem.get_side_flg(side_flg_);
+		// ある地点の周りにある、まだ通れる辺の数
+		// (ただしゴール地点だけ+1しておく)
+		problem.get_available_side_count(available_side_count_);
+		// 獲得可能な得点の上限を算出するための数値
+		problem.get_muladd_value(side_flg_, max_mul_value_, max_add_value_);
+		parity_cost_.assign(available_side_count_.size(), 0);
+		parity_cost_sum_ = 0;
+		for (size_t p = 0; p < parity_cost_.size(); ++p) {
+			update_parity_cost(p);
+		}
+		return problem.get_start();
+	}
+	// 今いる地点からnext_positionへ1歩進める(探索関数での「進める」と同じ操作)
+	// (next_positionへは、まだ通っていない辺で移動できること)
+	void move(const size_t now_position, const size_t next_position) noexcept {
+		for (const auto &dir : problem_->get_dir_list1(now_position)) {
+			if (dir.next_position != next_position || !side_flg_[dir.side_index])
+				continue;
+			--available_side_count_[now_position];
+			--available_side_count_[next_position];
+			result_.move_side(dir.step);
+			score_ = score_ * dir.mul_num + dir.add_num;
+			side_flg_[dir.side_index] = 0;
+			max_mul_value_ /= dir.bound_mul_num;
+			max_add_value_ -= dir.bound_add_num;
+			update_parity_cost(now_position);
+			update_parity_cost(next_position);
+			return;
+		}
+	}
+	// 普通の深さ優先探索を行い、最適解のスコアを返す(最適解の経路はbest_result_に入る)
+	// routeを渡した場合は、途中までの経路の後ろにrouteの地点を付け足した部分問題を解く
+	// corner_goal_flgがtrueなら、角にゴールがある場合はそれ用の探索関数を使う
+	// (同じSolverで繰り返し呼ばれた場合は、前回確保した領域を使い回す)
+	int dfs(const Problem &problem, const vector<size_t> &route, const bool corner_goal_flg) {
+		parity_flg_ = state_->parity_flg;
+		size_t position = load(problem);
+		for (const auto next_position : route) {
+			move(position, next_position);
+			position = next_position;
+		}
+		best_result_ = result_;
+		best_score_ = -9999;
+		// 終盤の探索に切り替える歩数を決める
+		// (複数の解を出力するモードでは、同点の別経路を数え落とすので切り替えない)
+		endgame_depth_ = std::numeric_limits<size_t>::max();
+		if (state_->endgame_size != 0 && route_list_ == nullptr) {
+			const size_t remaining = static_cast<size_t>(std::count(side_flg_.begin(), side_flg_.end(), 1));
+			endgame_depth_ = result_.size() + (remaining > state_->endgame_size ? remaining - state_->endgame_size : 0);
+			endgame_.reset(problem, state_->id != endgame_state_id_ || problem.get_goal() != endgame_goal_);
+			endgame_state_id_ = state_->id;
+			endgame_goal_ = problem.get_goal();
+		}
+		// 探索開始
+		if (corner_goal_flg && problem.corner_goal_flg(position)) {
+			// 始点と終点の奇偶を調べる
+			if (problem.is_odd(position)) {
+				dfs_cg_b(position);
+			}
+			else {
+				dfs_cg_a(position);
+			}
+		}
+		else {
+			// 始点と終点の奇偶を調べる
+			if (problem.is_odd(position)) {
+				dfs_b(position);
+			}
+			else {
+				dfs_a(position);
+			}
+		}
+		return best_score_;
+	}
+	void dfs_cg_a(const size_t now_position) noexcept {
+		// ゴール地点なら、とりあえずスコア判定を行う
+		if (now_position == problem_->get_goal()) {
+			if (is_record_candidate()) {
+				update_best_score();
+			}
+			return;
+		}
+		// 見込みスコアが現時点のベストスコアに劣っている場合や、最適解が確定した場合は戻る
+		if (is_hopeless(now_position, state_->best_score) || state_->stop_flg.load(std::memory_order_relaxed))
+			return;
+		// 残りの辺が少なくなったら、終盤の探索に切り替える
+		if (result_.size() >= endgame_depth_ && solve_endgame(now_position))
+			return;
+		// ネストを深くする
+		--available_side_count_[now_position];
+		const int old_parity_cost = update_parity_cost(now_position);
+		// 候補手をまとめて評価し、生き残ったものだけを展開する
+		const auto dir_list = problem_->get_dir_list2(now_position);
+		for (unsigned int mask = filter_dir_list2(dir_list); mask != 0; mask &= mask - 1) {
+			const Move2 &dir = dir_list[bit_scan_forward(mask)];
+			const int side_index1 = dir.side_index1, side_index2 = dir.side_index2;
+			const int next_position2 = dir.next_position2;
+			// 進める
+			const int old_score = score_;
+			--available_side_count_[next_position2];
+			result_.move_side(dir.step1);
+			result_.move_side(dir.step2);
+			score_ = score_ * dir.mul_num + dir.add_num;
+			side_flg_[side_index1] = 0;
+			side_flg_[side_index2] = 0;
+			max_mul_value_ /= dir.bound_mul_num;
+			max_add_value_ -= dir.bound_add_num;
+			// 再帰を一段階深くする
+			dfs_cg_a(next_position2);
+			// 戻す
+			side_flg_[side_index1] = 1;
+			side_flg_[side_index2] = 1;
+			max_mul_value_ *= dir.bound_mul_num;
+			max_add_value_ += dir.bound_add_num;
+			result_.back_side2();
+			++available_side_count_[next_position2];
+			score_ = old_score;
+		}
+		restore_parity_cost(now_position, old_parity_cost);
+		++available_side_count_[now_position];
+	}
+	void dfs_cg_b(const size_t now_position) noexcept {
+		// ゴール地点なら、とりあえずスコア判定を行う
+		if (now_position == problem_->get_goal()) {
+			if (is_record_candidate()) {
+				update_best_score();
+			}
+			return;
+		}
+		// 見込みスコアが現時点のベストスコアに劣っている場合や、最適解が確定した場合は戻る
+		if (is_hopeless(now_position, state_->best_score) || state_->stop_flg.load(std::memory_order_relaxed))
+			return;
+		// 残りの辺が少なくなったら、終盤の探索に切り替える
+		if (result_.size() >= endgame_depth_ && solve_endgame(now_position))
+			return;
+		// ネストを深くする
+		--available_side_count_[now_position];
+		const int old_parity_cost = update_parity_cost(now_position);
+		for (const auto &dir : problem_->get_dir_list1(now_position)) {
+			if (!side_flg_[dir.side_index])
+				continue;
+			if (available_side_count_[dir.next_position] <= 1)
+				continue;
+			// 進める
+			const int old_score = score_;
+			--available_side_count_[dir.next_position];
+			result_.move_side(dir.step);
+			score_ = score_ * dir.mul_num + dir.add_num;
+			side_flg_[dir.side_index] = 0;
+			max_mul_value_ /= dir.bound_mul_num;
+			max_add_value_ -= dir.bound_add_num;
+			// 再帰を一段階深くする
+			dfs_cg_a(dir.next_position);
+			// 戻す
+			side_flg_[dir.side_index] = 1;
+			max_mul_value_ *= dir.bound_mul_num;
+			max_add_value_ += dir.bound_add_num;
+			result_.back_side();
+			++available_side_count_[dir.next_position];
+			score_ = old_score;
+		}
+		restore_parity_cost(now_position, old_parity_cost);
+		++available_side_count_[now_position];
+	}
+	void dfs_a(const size_t now_position) noexcept {
+		// ゴール地点なら、とりあえずスコア判定を行う
+		if (now_position == problem_->get_goal()) {
+			if (is_record_candidate()) {
+				update_best_score();
+			}
+		}
+		// 見込みスコアが現時点のベストスコアに劣っている場合や、最適解が確定した場合は戻る
+		if (is_hopeless(now_position, state_->best_score) || state_->stop_flg.load(std::memory_order_relaxed))
+			return;
+		// 残りの辺が少なくなったら、終盤の探索に切り替える
+		if (result_.size() >= endgame_depth_ && solve_endgame(now_position))
+			return;
+		// ネストを深くする
+		--available_side_count_[now_position];
+		const int old_parity_cost = update_parity_cost(now_position);
+		// 候補手をまとめて評価し、生き残ったものだけを展開する
+		const auto dir_list = problem_->get_dir_list2(now_position);
+		for (unsigned int mask = filter_dir_list2(dir_list); mask != 0; mask &= mask - 1) {
+			const Move2 &dir = dir_list[bit_scan_forward(mask)];
+			const int side_index1 = dir.side_index1, side_index2 = dir.side_index2;
+			const int next_position2 = dir.next_position2;
+			// 進める
+			const int old_score = score_;
+			--available_side_count_[next_position2];
+			result_.move_side(dir.step1);
+			result_.move_side(dir.step2);
+			score_ = score_ * dir.mul_num + dir.add_num;
+			side_flg_[side_index1] = 0;
+			side_flg_[side_index2] = 0;
+			max_mul_value_ /= dir.bound_mul_num;
+			max_add_value_ -= dir.bound_add_num;
+			// 再帰を一段階深くする
+			dfs_a(next_position2);
+			// 戻す
+			side_flg_[side_index1] = 1;
+			side_flg_[side_index2] = 1;
+			max_mul_value_ *= dir.bound_mul_num;
+			max_add_value_ += dir.bound_add_num;
+			result_.back_side2();
+			++available_side_count_[next_position2];
+			score_ = old_score;
+		}
+		restore_parity_cost(now_position, old_parity_cost);
+		++available_side_count_[now_position];
+	}
+	void dfs_b(const size_t now_position) noexcept {
+		// ゴール地点なら、とりあえずスコア判定を行う
+		if (now_position == problem_->get_goal()) {
+			if (is_record_candidate()) {
+				update_best_score();
+			}
+			return;
+		}
+		// 見込みスコアが現時点のベストスコアに劣っている場合や、最適解が確定した場合は戻る
+		if (is_hopeless(now_position, state_->best_score) || state_->stop_flg.load(std::memory_order_relaxed))
+			return;
+		// 残りの辺が少なくなったら、終盤の探索に切り替える
+		if (result_.size() >= endgame_depth_ && solve_endgame(now_position))
+			return;
+		// ネストを深くする
+		--available_side_count_[now_position];
+		const int old_parity_cost = update_parity_cost(now_position);
+		for (const auto &dir : problem_->get_dir_list1(now_position)) {
+			if (!side_flg_[dir.side_index])
+				continue;
+			if (available_side_count_[dir.next_position] <= 1)
+				continue;
+			// 進める
+			const int old_score = score_;
+			--available_side_count_[dir.next_position];
+			result_.move_side(dir.step);
+			score_ = score_ * dir.mul_num + dir.add_num;
+			side_flg_[dir.side_index] = 0;
+			max_mul_value_ /= dir.bound_mul_num;
+			max_add_value_ -= dir.bound_add_num;
+			// 再帰を一段階深くする
+			dfs_a(dir.next_position);
+			// 戻す
+			side_flg_[dir.side_index] = 1;
+			max_mul_value_ *= dir.bound_mul_num;
+			max_add_value_ += dir.bound_add_num;
+			result_.back_side();
+			++available_side_count_[dir.next_position];
+			score_ = old_score;
+		}
+		restore_parity_cost(now_position, old_parity_cost);
+		++available_side_count_[now_position];
+	}
+public:
+	// コンストラクタ
+	Solver() {}
+	// 部分問題の一覧を作る
+	// 問題を分割し、見込みスコアの高い順に並べる
+	// (見込みスコアの高い部分問題から解くことで、良いベストスコアを早めに見つける。
+	//   threadsが1の場合は、分割せずに問題全体を1つの部分問題として解く)
+	// (上位K件・全最適解のモードでは、同点の別経路も必要なので、同じ状態をまとめない)
+	// (見込みスコアがmin_score未満の部分問題は、解く必要が無いものとして捨てる)
+	void prepare(SearchState &state, const unsigned int threads, const int min_score = -9999) {
+		const int64_t begin_time = (g_tracer != nullptr ? g_tracer->now() : 0);
+		prepare(state, split(state.problem, (threads == 1 ? 1 : threads * 100), min_score, !state.route_list));
+		if (g_tracer != nullptr)
+			g_tracer->complete("split", begin_time, static_cast<int64_t>(state.split_list.size()));
+	}
+	// 分割済みの部分問題の一覧(ジョブファイルから読み込んだものなど)を、見込みスコアの高い順に並べる
+	void prepare(SearchState &state, vector<SplitTask> split_list) const {
+		state.split_list = std::move(split_list);
+		state.task_list.clear();
+		for (size_t i = 0; i < state.split_list.size(); ++i) {
+			state.task_list.emplace_back(state.split_list[i].upper_score, i);
+		}
+		std::stable_sort(state.task_list.begin(), state.task_list.end(),
+			[](const std::pair<int, size_t> &a, const std::pair<int, size_t> &b) { return a.first > b.first; });
+	}
+	// スタート・ゴールの候補の組み合わせ全てを部分問題とする
+	// (盤面は1つを共有し、ワーカーごとにスタート・ゴールだけを付け替えて解く。
+	//   ベストスコアも全ての組み合わせで共有するので、後から解く組み合わせほど枝刈りが効く)
+	void prepare_free(SearchState &state, const vector<size_t> &start_list, const vector<size_t> &goal_list) const {
+		const Problem &problem = state.problem;
+		if (problem.get_pre_root().size() > 1)
+			throw "途中までの経路がある問題では、スタート・ゴールを自由に選べません。";
+		// 組み合わせを、良い解が見つかりやすそうな順に並べる
+		// 一筆書きでは、経路の途中の地点は「使った辺の数」が偶数になる。そのため、
+		// 辺の数が奇数の地点(盤面の縁など)をスタート・ゴールにした方が、多くの辺を使い切れる
+		state.pair_list.clear();
+		state.task_list.clear();
+		for (const auto start : start_list) {
+			for (const auto goal : goal_list) {
+				int odd_count = 0;
+				if (problem.get_dir_list(start).size() % 2 == 1)
+					++odd_count;
+				if (problem.get_dir_list(goal).size() % 2 == 1)
+					++odd_count;
+				state.task_list.emplace_back(odd_count, state.pair_list.size());
+				state.pair_list.emplace_back(start, goal);
+			}
+		}
+		std::stable_sort(state.task_list.begin(), state.task_list.end(),
+			[](const std::pair<int, size_t> &a, const std::pair<int, size_t> &b) { return a.first > b.first; });
+		// (見込みスコアはスタート・ゴールによらず同じになるので、並べ替えた後に付け直す)
+		for (auto &task : state.task_list) {
+			task.first = state.upper_score;
+		}
+	}
+	// ポートフォリオモードの部分問題を作る
+	// 各部分問題は問題全体で、候補手を試す順番と探索関数だけがconfig_listの通りに違う
+	// (ワーカーはそれぞれ1つを解き、ベストスコアは全ワーカーで共有する。
+	//   悪い順番に当たった探索も、他の探索が見つけた解で枝刈りできる)
+	void prepare_portfolio(SearchState &state, const vector<PortfolioConfig> &config_list) const {
+		state.portfolio_list = config_list;
+		state.portfolio_problem_list.assign(config_list.size(), state.problem);
+		state.task_list.clear();
+		for (size_t i = 0; i < config_list.size(); ++i) {
+			state.portfolio_problem_list[i].set_move_order(config_list[i].order, config_list[i].seed);
+			state.task_list.emplace_back(state.upper_score, i);
+		}
+	}
+	// 部分問題の一覧を、workers個のワーカーでpoolに解かせる
+	// 解き終えるとstate->on_finishが呼ばれ、state->wait()から戻る
+	// ・各ワーカーは、並べた順に部分問題を1つ取り出して解くと、自分自身をpoolへ投げ直す
+	//   (同じpoolで複数の探索を同時に進めた場合でも、部分問題1つごとに順番が回ってくる)
+	// ・取り出した時点で、見込みスコアが現時点のベストスコアに届かなければ打ち切る
+	//   (以降の部分問題は見込みスコアがより低いので、全て解く必要が無い)
+	// ・最適解が確定した場合も打ち切る
+	// pin_flgがtrueなら、poolの各スレッドを別々のCPUコアに固定する
+	static void start(ThreadPool &pool, const std::shared_ptr<SearchState> &state, unsigned int workers, const bool pin_flg) {
+		workers = static_cast<unsigned int>(std::max<size_t>(1, std::min<size_t>(workers, state->task_list.size())));
+		state->running_count = workers;
+		if (g_tracer != nullptr)
+			g_tracer->keep(*state);
+		for (unsigned int t = 0; t < workers; ++t) {
+			// (作業領域の問題は、スタート・ゴールを自由に選ぶモードでのみ使う)
+			auto work = std::make_shared<Problem>();
+			const int64_t queued_time = (g_tracer != nullptr ? g_tracer->now() : 0);
+			pool.enqueue([&pool, state, work, pin_flg, queued_time] { run_task(pool, state, work, pin_flg, queued_time); });
+		}
+	}
+	// 解を探索する(コマンドラインから実行した場合に使う)
+	// threads個のワーカースレッドを立て、解き終えるまで待つ
+	static void solve(const std::shared_ptr<SearchState> &state, const unsigned int threads, const bool pin_flg = false) {
+		ThreadPool pool(threads);
+		start(pool, state, threads, pin_flg);
+		state->wait();
+	}
+	// 問題を分割せずに、このスレッドだけで解く(検証モードで、各探索関数を個別に試すのに使う)
+	// corner_goal_flgがfalseなら、角にゴールがある問題でも通常の探索関数を使う
+	std::pair<Result, int> solve_single(const Problem &problem, const bool corner_goal_flg) {
+		SearchState state(problem);
+		state_ = &state;
+		route_list_ = nullptr;
+		const int score = dfs(problem, vector<size_t>(), corner_goal_flg);
+		state_ = nullptr;
+		return std::pair<Result, int>(best_result_, score);
+	}
+private:
+	// ワーカーの1回分の処理(部分問題を1つ解く)
+	// (queued_timeは、この処理をpoolへ投げた時刻。トレースを記録する場合にだけ使う)
+	static void run_task(ThreadPool &pool, const std::shared_ptr<SearchState> &state, const std::shared_ptr<Problem> &work, const bool pin_flg, const int64_t queued_time) {
+		if (pin_flg)
+			pin_worker_thread();
+		// (poolのキューで待っていた期間。ワーカーの空き待ちとキューの排他制御の待ちを含む)
+		if (g_tracer != nullptr)
+			g_tracer->complete("queued", queued_time);
+		// ワーカースレッドごとに1つだけSolverを作り、部分問題間・探索間で使い回す
+		static thread_local Solver worker_solver;
+		const size_t i = state->next_task++;
+		if (!state->stop_flg && i < state->task_list.size() && state->task_list[i].first >= state->best_score) {
+			worker_solver.state_ = state.get();
+			worker_solver.route_list_ = state->route_list.get();
+			const size_t index = state->task_list[i].second;
+			const int64_t begin_time = (g_tracer != nullptr ? g_tracer->now() : 0);
+			int score;
+			if (state->free_flg())
+				score = worker_solver.dfs(state->get_free_problem(index, *work), vector<size_t>(), true);
+			else if (state->portfolio_flg())
+				score = worker_solver.dfs(state->portfolio_problem_list[index], vector<size_t>(), state->portfolio_list[index].corner_goal_flg);
+			else
+				score = worker_solver.dfs(state->problem, state->split_list[index].route, true);
+			{
+				std::lock_guard<std::mutex> lock(state->mtx);
+				if (state->best.second < score) {
+					state->best.first = worker_solver.best_result_;
+					state->best.second = score;
+				}
+				// (ポートフォリオモードでは、どれか1つが打ち切られずに探索し終えた時点で最適解が確定する)
+				if (state->portfolio_flg())
+					state->stop_flg = true;
+				if (state->keep_found_flg && score != -9999)
+					state->found_list.emplace_back(score, worker_solver.best_result_);
+			}
+			// (部分問題の番号iは、見込みスコアの高い順に並べた中での順位)
+			if (g_tracer != nullptr)
+				g_tracer->complete_task("subproblem", begin_time, score, *state, i, index);
+			const int64_t next_queued_time = (g_tracer != nullptr ? g_tracer->now() : 0);
+			pool.enqueue([&pool, state, work, pin_flg, next_queued_time] { run_task(pool, state, work, pin_flg, next_queued_time); });
+			return;
+		}
+		if (g_tracer != nullptr)
+			g_tracer->instant("worker_exit", static_cast<int64_t>(i));
+		// 最後のワーカーが終わったら、探索全体を終える
+		{
+			std::lock_guard<std::mutex> lock(state->mtx);
+			if (--state->running_count != 0)
+				return;
+			state->finish_flg = true;
+		}
+		state->finish_cv.notify_all();
+		if (state->on_finish)
+			state->on_finish(*state);
+	}
+	// 分割用の深さ優先探索の状態
+	struct SplitContext {
+		// 何手先まで展開するか
+		size_t max_depth;
+		// 見込みスコアがこれ未満の状態は捨てる
+		int min_score;
+		// 同じ状態をまとめるか？
+		bool dedup_flg;
+		// 付け足した経路
+		vector<size_t> route;
+		// 作った部分問題
+		vector<SplitTask> task_list;
+		// (今いる地点, 使った辺の集合) → (その状態に着いた際の最高得点, 部分問題にした場合はその番号)
+		std::map<std::pair<size_t, vector<uint64_t>>, std::pair<int, size_t>> visited;
+		// max_depthで展開を打ち切った状態があったか？
+		bool cut_flg;
+	};
+	void split_dfs(SplitContext &context, const size_t now_position) {
+		// 見込みスコアが足りなければ捨てる
+		const int upper_score = get_upper_score(now_position);
+		if (upper_score < context.min_score)
+			return;
+		// ゴール地点にいる状態は、それ以上展開せずに部分問題にする
+		// (展開すると、「ここで止まる」経路が失われてしまうため。そのまま解けば、止まる経路も先へ進む経路も調べられる)
+		const bool leaf_flg = (now_position == problem_->get_goal() || context.route.size() == context.max_depth);
+		const size_t no_task = static_cast<size_t>(-1);
+		std::pair<int, size_t> *visited = nullptr;
+		if (context.dedup_flg) {
+			// 同じ状態に、より高い(か同じ)得点で着いたことがあれば、この状態は調べなくてよい
+			vector<uint64_t> side_bits(side_flg_.size() / 64 + 1, 0);
+			for (size_t i = 0; i < side_flg_.size(); ++i) {
+				if (side_flg_[i])
+					side_bits[i / 64] |= uint64_t(1) << (i % 64);
+			}
+			const auto it = context.visited.emplace(std::make_pair(now_position, std::move(side_bits)), std::make_pair(score_, no_task));
+			visited = &it.first->second;
+			if (!it.second) {
+				if (score_ <= visited->first)
+					return;
+				visited->first = score_;
+			}
+		}
+		if (leaf_flg) {
+			if (now_position != problem_->get_goal())
+				context.cut_flg = true;
+			SplitTask task{ context.route, score_, upper_score };
+			// (同じ状態の部分問題を既に作っていれば、得点の高いこちらで置き換える)
+			if (visited != nullptr && visited->second != no_task) {
+				context.task_list[visited->second] = task;
+				return;
+			}
+			if (visited != nullptr)
+				visited->second = context.task_list.size();
+			context.task_list.push_back(task);
+			return;
+		}
+		// 1歩ずつ展開する(探索関数と同じく、行き止まりに入る手は除く)
+		--available_side_count_[now_position];
+		for (const auto &dir : problem_->get_dir_list1(now_position)) {
+			if (!side_flg_[dir.side_index])
+				continue;
+			if (available_side_count_[dir.next_position] <= 1)
+				continue;
+			// 進める
+			const int old_score = score_;
+			--available_side_count_[dir.next_position];
+			score_ = score_ * dir.mul_num + dir.add_num;
+			side_flg_[dir.side_index] = 0;
+			max_mul_value_ /= dir.bound_mul_num;
+			max_add_value_ -= dir.bound_add_num;
+			context.route.push_back(dir.next_position);
+			split_dfs(context, dir.next_position);
+			// 戻す
+			context.route.pop_back();
+			side_flg_[dir.side_index] = 1;
+			max_mul_value_ *= dir.bound_mul_num;
+			max_add_value_ += dir.bound_add_num;
+			++available_side_count_[dir.next_position];
+			score_ = old_score;
+		}
+		++available_side_count_[now_position];
+	}
+public:
+	// 問題を分割する
+	// ・深さ優先で一定の手数まで展開し、そこで止めた状態(と、それより手前でゴールに着いた状態)を部分問題とする。
+	//   部分問題の数がsplits以上になるまで、手数を1つずつ増やしてやり直す
+	//   (部分問題は付け足した経路だけで表すので、展開中にProblemをコピーしない)
+	// ・見込みスコアがmin_score未満の状態は捨てる(それより良い解が無い部分問題なので、解く必要が無い)
+	// ・dedup_flgがtrueなら、「今いる地点」と「使った辺の集合」が同じ状態は、得点が最も高いものだけを残す
+	//   (演算は全て得点について単調増加(掛ける数は0以上)なので、その後の経路が同じなら、得点が高い方が常に良い)
+	vector<SplitTask> split(const Problem &problem, const size_t splits, const int min_score = -9999, const bool dedup_flg = true) {
+		SplitContext context;
+		context.min_score = min_score;
+		context.dedup_flg = dedup_flg;
+		// (分割では見込みスコアを奇偶で補正しない)
+		parity_flg_ = false;
+		for (context.max_depth = 0; ; ++context.max_depth) {
+			context.task_list.clear();
+			context.visited.clear();
+			context.cut_flg = false;
+			split_dfs(context, load(problem));
+			// (これ以上展開できる状態が無い場合も終える)
+			if (context.task_list.size() >= splits || !context.cut_flg)
+				break;
+		}
+		return context.task_list;
+	}
+};
+
+// 分割せずに1秒だけ探索し、解き終えていればtrueを返す
+// (解き終えていなくても、それまでに見つけた解はstate->bestに入る)
+inline bool probe_search(const std::shared_ptr<SearchState> &state) {
+	Solver solver;
+	solver.prepare(*state, 1);
+	ThreadPool pool(1);
+	Solver::start(pool, state, 1, false);
+	const bool optimal_flg = state->wait_for(std::chrono::seconds(1));
+	if (!optimal_flg) {
+		state->stop_flg = true;
+		state->wait();
+	}
+	return optimal_flg;
+}
+
+// 目標スコアを決めてから探索する(aspiration search)
+// 目標スコアT以上の解だけを探すなら、ベストスコアをT-1として始められるので、最初から強く枝刈りできる。
+// 見つかればそれが最適解で、見つからなければ最適解はT未満と分かるので、Tを下げて探索し直す。
+// ・Tを下げる際は、それまでに見つかった解を初期の解とし、盤面全体の見込みスコアをT-1とする
+// ・下げ幅は、設定の下げ幅が0なら「見つかっている解の得点」と「T-1」の中間まで(二分法)、
+//   そうでなければ下げ幅・その2倍・4倍……とする
+// ・Tが見つかっている解の得点以下になった回は、その解から始める通常の探索と同じなので、必ずそこで終わる
+// (stateに初期の解が入っていれば、それを起点にする。解き終えるとstate->bestに最適解が入る)
+inline void solve_aspiration(const std::shared_ptr<SearchState> &state, const unsigned int threads, const bool pin_flg, int target, int window) {
+	const Problem &problem = state->problem;
+	// (最適解の得点はupper以下であり、見つかっている解の得点はstate->best.secondである)
+	int upper = state->upper_score;
+	while (state->best.second < upper) {
+		target = std::max(std::min(target, upper), state->best.second);
+		const auto pass = std::make_shared<SearchState>(problem);
+		pass->upper_score = upper;
+		pass->best = state->best;
+		// (Tちょうどにすると、見込みスコアがTの回では、T未満の解を見つけただけで打ち切られてしまう)
+		pass->best_score = target - 1;
+		Solver().prepare(*pass, threads, target);
+		Solver::solve(pass, threads, pin_flg);
+		state->best = pass->best;
+		if (state->best.second >= target)
+			break;
+		upper = target - 1;
+		if (window == 0) {
+			target = static_cast<int>(state->best.second + (static_cast<int64_t>(upper) - state->best.second + 1) / 2);
+		}
+		else {
+			target -= window;
+			window = (window > std::numeric_limits<int>::max() / 2 ? window : window * 2);
+		}
+	}
+	state->best_score = state->best.second;
+	state->finish_flg = true;
+}
+
+
+// 逆向きの探索(ゴールからスタートへ向かって探索する)
+// 演算は全て1次関数(x → mul*x + add)なので、ゴールから逆に辿った部分の演算を1つの1次関数(A*x + B)にまとめて持ち、
+// スタートに着いた時点で、途中までの経路を辿った後の得点に当てはめて得点を求める。
+// ・掛ける数は0以上なのでAも0以上であり、スタートからここまでの経路の得点の上限をUとすると、得点の上限はA*U + Bになる
+//   (Uは、通常の探索の見込みスコアと同じく、まだ通れる辺の加算分・乗算分から求める)
+// ・スタートは、通常の探索でのゴールと同じく、そこで止まることも通り過ぎることもできる
+// ・行き止まりの判定は、ゴールの代わりにスタートを+1した「まだ通れる辺の数」で行う
+// ・並列化は、ゴールから一定の手数まで展開した状態を部分問題とし、見込みスコアの高い順にワーカーへ配る
+//   (ベストスコアは全ワーカーで共有する)
+// 最適解1つだけを求める場合に限る(上位K件・全最適解・スタート・ゴールを自由に選ぶモード等には使えない)
+class BackwardSolver {
+	const Problem *problem_ = nullptr;
+	SearchState *state_ = nullptr;
+	// ある辺を踏破したか？
+	vector<int> side_flg_;
+	// ある地点の周りにある、まだ通れる辺の数(ただしスタート地点だけ+1しておく)
+	vector<int> available_side_count_;
+	// 獲得可能な得点の上限を算出するための数値
+	int max_mul_value_, max_add_value_;
+	// ゴールから逆に辿った部分の演算(A*x + B)
+	int64_t mul_value_, add_value_;
+	// ゴールから逆に辿った経路(先頭がゴール)
+	vector<size_t> route_;
+	// このワーカーが見つけた最も良い解
+	int best_score_;
+	Result best_result_;
+	// 分割用の状態
+	struct SplitContext {
+		size_t max_depth;
+		vector<vector<size_t>> task_list;
+		bool cut_flg;
+	};
+	// 見込みスコア
+	int get_upper_score() const noexcept {
+		const int64_t x = problem_->get_pre_score() + max_add_value_;
+		// (Aとmax_mul_value_は別々の辺の乗算分なので、積は盤面全体の乗算分を超えない。先に掛けておけば64bitに収まる)
+		const int64_t upper = (x < 0 ? mul_value_ * x : mul_value_ * max_mul_value_ * x) + add_value_;
+		return static_cast<int>(std::max<int64_t>(std::min<int64_t>(upper, std::numeric_limits<int>::max()), std::numeric_limits<int>::min()));
+	}
+	// 1歩進める・戻す(逆向きなので、演算は手前側に合成する)
+	void move(const Move1 &dir) noexcept {
+		--available_side_count_[dir.next_position];
+		side_flg_[dir.side_index] = 0;
+		add_value_ += mul_value_ * dir.add_num;
+		mul_value_ *= dir.mul_num;
+		max_mul_value_ /= dir.bound_mul_num;
+		max_add_value_ -= dir.bound_add_num;
+		route_.push_back(dir.next_position);
+	}
+	void back(const Move1 &dir, const int64_t old_mul_value, const int64_t old_add_value) noexcept {
+		route_.pop_back();
+		max_mul_value_ *= dir.bound_mul_num;
+		max_add_value_ += dir.bound_add_num;
+		mul_value_ = old_mul_value;
+		add_value_ = old_add_value;
+		side_flg_[dir.side_index] = 1;
+		++available_side_count_[dir.next_position];
+	}
+	// スタートに着いた際、今の解が良ければ記録する
+	void record() {
+		const int score = static_cast<int>(mul_value_ * problem_->get_pre_score() + add_value_);
+		if (score <= best_score_)
+			return;
+		best_score_ = score;
+		best_result_.reset(*problem_);
+		for (size_t i = route_.size() - 1; i > 0; --i) {
+			best_result_.move_side(get_step_code(route_[i], route_[i - 1], problem_->get_width()));
+		}
+		std::lock_guard<std::mutex> lock(state_->mtx);
+		if (state_->best_score < best_score_) {
+			state_->best_score = best_score_;
+			state_->best = std::pair<Result, int>(best_result_, best_score_);
+			if (state_->on_improve)
+				state_->on_improve(best_result_, best_score_);
+		}
+		if (state_->best_score >= state_->upper_score)
+			state_->stop_flg = true;
+	}
+	// 深さ優先探索
+	void dfs(const size_t now_position) {
+		if (state_->stop_flg)
+			return;
+		if (get_upper_score() <= std::max(best_score_, state_->best_score))
+			return;
+		if (now_position == problem_->get_start())
+			record();
+		--available_side_count_[now_position];
+		for (const auto &dir : problem_->get_dir_list1(now_position)) {
+			if (!side_flg_[dir.side_index])
+				continue;
+			if (available_side_count_[dir.next_position] <= 1)
+				continue;
+			const int64_t old_mul_value = mul_value_, old_add_value = add_value_;
+			move(dir);
+			dfs(dir.next_position);
+			back(dir, old_mul_value, old_add_value);
+		}
+		++available_side_count_[now_position];
+	}
+	// 分割用の深さ優先探索(途中でスタートに着いた解は、その場で記録する)
+	void split_dfs(SplitContext &context, const size_t now_position) {
+		if (now_position == problem_->get_start())
+			record();
+		if (route_.size() - 1 == context.max_depth) {
+			context.cut_flg = true;
+			context.task_list.push_back(route_);
+			return;
+		}
+		--available_side_count_[now_position];
+		for (const auto &dir : problem_->get_dir_list1(now_position)) {
+			if (!side_flg_[dir.side_index])
+				continue;
+			if (available_side_count_[dir.next_position] <= 1)
+				continue;
+			const int64_t old_mul_value = mul_value_, old_add_value = add_value_;
+			move(dir);
+			split_dfs(context, dir.next_position);
+			back(dir, old_mul_value, old_add_value);
+		}
+		++available_side_count_[now_position];
+	}
+	// 初期状態にする(ゴールにいて、まだ何も辿っていない状態)
+	void load(SearchState &state) {
+		state_ = &state;
+		problem_ = &state.problem;
+		problem_->get_side_flg(side_flg_);
+		problem_->get_available_side_count(available_side_count_);
+		--available_side_count_[problem_->get_goal()];
+		++available_side_count_[problem_->get_start()];
+		problem_->get_muladd_value(side_flg_, max_mul_value_, max_add_value_);
+		mul_value_ = 1;
+		add_value_ = 0;
+		route_.assign(1, problem_->get_goal());
+		best_score_ = -9999;
+		best_result_.reset(*problem_);
+	}
+	// 部分問題(ゴールから逆に辿った経路)の終点まで進める
+	void replay(const vector<size_t> &task) {
+		for (size_t i = 1; i < task.size(); ++i) {
+			--available_side_count_[task[i - 1]];
+			for (const auto &dir : problem_->get_dir_list1(task[i - 1])) {
+				if (dir.next_position == task[i] && side_flg_[dir.side_index]) {
+					move(dir);
+					break;
+				}
+			}
+		}
+	}
+public:
+	// stateの問題を、threads個のワーカーで逆向きに探索して解く
+	// (stateに初期の解が入っていれば、それを起点にする。解き終えるとstate->bestに最適解が入る)
+	static void solve(const std::shared_ptr<SearchState> &state, const unsigned int threads) {
+		state->best_score = state->best.second;
+		// 分割する(部分問題の数がthreads*100以上になるまで、手数を1つずつ増やしてやり直す)
+		BackwardSolver splitter;
+		SplitContext context;
+		splitter.load(*state);
+		for (context.max_depth = 0; ; ++context.max_depth) {
+			context.task_list.clear();
+			context.cut_flg = false;
+			splitter.split_dfs(context, state->problem.get_goal());
+			if (threads == 1 || context.task_list.size() >= threads * 100 || !context.cut_flg)
+				break;
+		}
+		// 見込みスコアの高い順に並べる
+		vector<std::pair<int, size_t>> task_list;
+		for (size_t i = 0; i < context.task_list.size(); ++i) {
+			splitter.load(*state);
+			splitter.replay(context.task_list[i]);
+			task_list.emplace_back(splitter.get_upper_score(), i);
+		}
+		std::stable_sort(task_list.begin(), task_list.end(),
+			[](const std::pair<int, size_t> &a, const std::pair<int, size_t> &b) { return a.first > b.first; });
+		// ワーカーは部分問題を1つずつ取り出して解く
+		std::atomic<size_t> next_task(0);
+		{
+			ThreadPool pool(threads);
+			vector<std::future<void>> future_list;
+			for (unsigned int t = 0; t < threads; ++t) {
+				future_list.push_back(pool.enqueue([&] {
+					BackwardSolver solver;
+					for (size_t i = next_task++; i < task_list.size() && !state->stop_flg; i = next_task++) {
+						if (task_list[i].first <= state->best_score)
+							break;
+						const auto &task = context.task_list[task_list[i].second];
+						solver.load(*state);
+						solver.replay(task);
+						solver.dfs(task.back());
+					}
+				}));
+			}
+			for (auto &future : future_list) {
+				future.get();
+			}
+		}
+		state->finish_flg = true;
+	}
+};
+
+// 探索の向きを決めるため、探索木の大きさを推定する
+// 起点(順向きならスタート、逆向きならゴール)から、次の手を除いた候補手を一様に選んで進むランダムな経路を作り、
+// 候補手の数の積を重みとして、通った局面ごとに足し込む(Knuthの推定法)。重みの平均は、探索木の局面の数の推定値になる
+// ・まだ使っていない辺だけでは終点へ行けなくなる手
+// ・進んだ後の見込みスコア(その向きの探索と同じ求め方)がthreshold未満になる手
+// (thresholdは、ベストスコアがそこまで上がった後の探索木を見積もるためのもの。
+//   found_scoreには、ランダムな経路が終点を通った際の得点の最大値を入れる)
+inline double estimate_tree_size(const Problem &problem, const bool backward_flg, const size_t samples, const unsigned int seed, const int threshold, int &found_score) {
+	const size_t origin = (backward_flg ? problem.get_goal() : problem.get_start());
+	const size_t target = (backward_flg ? problem.get_start() : problem.get_goal());
+	const int64_t pre_score = problem.get_pre_score();
+	std::mt19937 rand(seed);
+	vector<int> side_flg;
+	problem.get_side_flg(side_flg);
+	int initial_max_mul_value, initial_max_add_value;
+	problem.get_muladd_value(side_flg, initial_max_mul_value, initial_max_add_value);
+	const size_t point_count = problem.get_width() * problem.get_height();
+	vector<char> visited;
+	vector<size_t> stack, used_list;
+	vector<const Move1*> candidate_list;
+	// まだ使っていない辺だけで、positionから終点へ行けるか？
+	const auto reachable = [&](const size_t position) {
+		if (position == target)
+			return true;
+		visited.assign(point_count, 0);
+		stack.assign(1, position);
+		visited[position] = 1;
+		while (!stack.empty()) {
+			const size_t p = stack.back();
+			stack.pop_back();
+			for (const auto &dir : problem.get_dir_list1(p)) {
+				if (!side_flg[dir.side_index] || visited[dir.next_position])
+					continue;
+				if (dir.next_position == target)
+					return true;
+				visited[dir.next_position] = 1;
+				stack.push_back(dir.next_position);
+			}
+		}
+		return false;
+	};
+	found_score = -9999;
+	double sum = 0.0;
+	for (size_t i = 0; i < samples; ++i) {
+		size_t position = origin;
+		// 順向きでは今の得点をadd_valueに持ち、逆向きでは辿った部分の演算をmul_value*x + add_valueとして持つ
+		int64_t mul_value = 1, add_value = (backward_flg ? 0 : pre_score);
+		int max_mul_value = initial_max_mul_value, max_add_value = initial_max_add_value;
+		double weight = 1.0;
+		used_list.clear();
+		for (;;) {
+			sum += weight;
+			if (position == target)
+				found_score = std::max(found_score, static_cast<int>(mul_value * (backward_flg ? pre_score : 1) + add_value));
+			candidate_list.clear();
+			for (const auto &dir : problem.get_dir_list1(position)) {
+				if (!side_flg[dir.side_index])
+					continue;
+				// 見込みスコア(Solver::get_upper_score()・BackwardSolverと同じ求め方)
+				const int64_t next_mul_value = (backward_flg ? mul_value * dir.mul_num : 1);
+				const int64_t next_add_value = (backward_flg ? add_value + mul_value * dir.add_num : add_value * dir.mul_num + dir.add_num);
+				const int next_max_mul_value = max_mul_value / dir.bound_mul_num, next_max_add_value = max_add_value - dir.bound_add_num;
+				const int64_t x = (backward_flg ? pre_score : next_add_value) + next_max_add_value;
+				const int64_t upper = (backward_flg
+					? (x < 0 ? next_mul_value * x : next_mul_value * next_max_mul_value * x) + next_add_value
+					: (x < 0 ? x : x * next_max_mul_value));
+				if (upper < threshold)
+					continue;
+				side_flg[dir.side_index] = 0;
+				if (reachable(dir.next_position))
+					candidate_list.push_back(&dir);
+				side_flg[dir.side_index] = 1;
+			}
+			if (candidate_list.empty())
+				break;
+			const Move1 &dir = *candidate_list[std::uniform_int_distribution<size_t>(0, candidate_list.size() - 1)(rand)];
+			weight *= static_cast<double>(candidate_list.size());
+			side_flg[dir.side_index] = 0;
+			used_list.push_back(dir.side_index);
+			if (backward_flg) {
+				add_value += mul_value * dir.add_num;
+				mul_value *= dir.mul_num;
+			}
+			else
+				add_value = add_value * dir.mul_num + dir.add_num;
+			max_mul_value /= dir.bound_mul_num;
+			max_add_value -= dir.bound_add_num;
+			position = dir.next_position;
+		}
+		for (const auto side_index : used_list) {
+			side_flg[side_index] = 1;
+		}
+	}
+	return sum / static_cast<double>(std::max<size_t>(1, samples));
+}
+
+// 経路の数え上げの結果
+// スタートからゴールまでの経路(同じ辺を2回通らないもの。ゴールを通り過ぎて戻ってくる経路も含む)の、スコアごとの数
+struct RouteCount {
+	// スコア → 経路の数
+	std::map<int, uint64_t> histogram;
+	// 経路の数が64bitに収まらなかったか？(その場合、数は正しくない)
+	bool overflow_flg = false;
+	// 経路の数を足し込む
+	void add(const int score, const uint64_t count) {
+		uint64_t &sum = histogram[score];
+		if (sum + count < sum)
+			overflow_flg = true;
+		sum += count;
+	}
+	void merge(const RouteCount &other) {
+		for (const auto &bin : other.histogram) {
+			add(bin.first, bin.second);
+		}
+		overflow_flg = overflow_flg || other.overflow_flg;
+	}
+	// 経路の総数
+	uint64_t total() const noexcept {
+		uint64_t sum = 0;
+		for (const auto &bin : histogram) {
+			sum += bin.second;
+		}
+		return sum;
+	}
+};
+
+// 経路の数え上げの推定結果(RouteCountの数を、標本から推定した実数にしたもの)
+struct RouteEstimate {
+	// スコア → 経路の数の推定値
+	std::map<int, double> histogram;
+	// 使った標本(ランダムな経路)の数
+	size_t samples = 0;
+	// 経路の総数の推定値
+	double total() const noexcept {
+		double sum = 0.0;
+		for (const auto &bin : histogram) {
+			sum += bin.second;
+		}
+		return sum;
+	}
+};
+
+// 経路の数え上げ
+// ・厳密に数える場合は、(使った辺の集合, 今いる地点, そこまでの得点)ごとに経路の数をまとめ、
+//   使った辺の本数ごとに1段ずつ進める(辺を通る順番だけが違う経路は、同じ状態・同じ得点に着いた時点で1つにまとまる)。
+//   辺の集合は64bitで持つので、まだ通れる辺がmax_edges本より多い盤面は数えられない。
+//   また、まだ使っていない辺だけではゴールへ行けなくなった状態は、その段で捨てる
+// ・複数スレッドの場合は、分割(同じ状態をまとめない)した部分問題ごとに数え、結果を足し合わせる
+//   (部分問題をまたいだ状態はまとまらないので、1スレッドより全体の手間は増える)
+// ・推定する場合は、スタートから候補手を一様に選んで進むランダムな経路を作り、候補手の数の積を重みとして
+//   ゴールに着くたびに足し込む(Knuthの推定法)。重みの平均は経路の数の不偏推定値になる
+// ・どちらも、行き止まり(ゴール以外で、入ったら出られない地点)に入る手は除く(ゴールに着く経路が無いので、数は変わらない)
+class RouteCounter {
+public:
+	// 厳密に数える場合の、まだ通れる辺の本数の上限
+	static const size_t max_edges = 64;
+private:
+	// 状態(使った辺の集合, 今いる地点)に、ある得点で着く経路の数
+	// (1段分の状態はこれを並べた配列で持ち、ソートして同じ状態・同じ得点のものをまとめる)
+	struct StateCount {
+		uint64_t used_bits;
+		uint32_t position;
+		int score;
+		uint64_t count;
+		bool operator < (const StateCount &other) const noexcept {
+			if (used_bits != other.used_bits)
+				return used_bits < other.used_bits;
+			if (position != other.position)
+				return position < other.position;
+			return score < other.score;
+		}
+		bool same_key(const StateCount &other) const noexcept {
+			return used_bits == other.used_bits && position == other.position && score == other.score;
+		}
+	};
+	const Problem &problem_;
+	// 辺の番号 → 辺の集合でのビット位置(まだ通れない辺は-1)
+	vector<int> local_index_;
+	// 各地点の、まだ通れる辺の集合
+	vector<uint64_t> incident_bits_;
+	// まだ通れる辺の本数
+	size_t edge_count_ = 0;
+	// 1段分の状態を並べ替え、同じ状態・同じ得点のものをまとめる
+	static void normalize(vector<StateCount> &layer, bool &overflow_flg) {
+		std::sort(layer.begin(), layer.end());
+		size_t size = 0;
+		for (size_t i = 0; i < layer.size(); ++i) {
+			if (size != 0 && layer[size - 1].same_key(layer[i])) {
+				if (layer[size - 1].count + layer[i].count < layer[size - 1].count)
+					overflow_flg = true;
+				layer[size - 1].count += layer[i].count;
+			}
+			else {
+				layer[size++] = layer[i];
+			}
+		}
+		layer.resize(size);
+	}
+	// まだ使っていない辺だけを通って、positionからゴールへ行けるか？
+	// (visited・stackは作業領域)
+	bool reachable(const size_t position, const uint64_t used_bits, vector<char> &visited, vector<size_t> &stack) const {
+		const size_t goal = problem_.get_goal();
+		if (position == goal)
+			return true;
+		visited.assign(incident_bits_.size(), 0);
+		stack.assign(1, position);
+		visited[position] = 1;
+		while (!stack.empty()) {
+			const size_t p = stack.back();
+			stack.pop_back();
+			for (const auto &dir : problem_.get_dir_list1(p)) {
+				if ((used_bits >> local_index_[dir.side_index]) & 1 || visited[dir.next_position])
+					continue;
+				if (dir.next_position == goal)
+					return true;
+				visited[dir.next_position] = 1;
+				stack.push_back(dir.next_position);
+			}
+		}
+		return false;
+	}
+	// nextへ移動した後、そこから動けるか？(ゴールなら、そこで止まれるので常に動けるとする)
+	bool movable(const size_t next_position, const uint64_t used_bits) const noexcept {
+		return (next_position == problem_.get_goal() || (incident_bits_[next_position] & ~used_bits) != 0);
+	}
+	// 推定用のランダムな経路をsamples本作り、ゴールに着いた際の重みを得点ごとにhistogramへ足し込む
+	void sample(const size_t samples, const unsigned int seed, std::map<int, double> &histogram) const {
+		std::mt19937 rand(seed);
+		vector<int> side_flg;
+		vector<size_t> used_list;
+		problem_.get_side_flg(side_flg);
+		vector<const Move1*> candidate_list;
+		for (size_t i = 0; i < samples; ++i) {
+			size_t position = problem_.get_start();
+			int score = problem_.get_pre_score();
+			double weight = 1.0;
+			used_list.clear();
+			for (;;) {
+				if (position == problem_.get_goal())
+					histogram[score] += weight;
+				candidate_list.clear();
+				for (const auto &dir : problem_.get_dir_list1(position)) {
+					if (!side_flg[dir.side_index])
+						continue;
+					// (行き止まりに入る手は除く)
+					if (dir.next_position != problem_.get_goal()) {
+						size_t count = 0;
+						for (const auto &next : problem_.get_dir_list1(dir.next_position)) {
+							if (side_flg[next.side_index])
+								++count;
+						}
+						if (count <= 1)
+							continue;
+					}
+					candidate_list.push_back(&dir);
+				}
+				if (candidate_list.empty())
+					break;
+				const Move1 &dir = *candidate_list[std::uniform_int_distribution<size_t>(0, candidate_list.size() - 1)(rand)];
+				weight *= static_cast<double>(candidate_list.size());
+				side_flg[dir.side_index] = 0;
+				used_list.push_back(dir.side_index);
+				score = score * dir.mul_num + dir.add_num;
+				position = dir.next_position;
+			}
+			for (const auto side_index : used_list) {
+				side_flg[side_index] = 1;
+			}
+		}
+	}
+public:
+	// コンストラクタ(problemは、数え上げを終えるまで呼び出し元が保持すること)
+	explicit RouteCounter(const Problem &problem) : problem_(problem) {
+		vector<int> side_flg;
+		problem.get_side_flg(side_flg);
+		local_index_.assign(side_flg.size(), -1);
+		for (size_t i = 0; i < side_flg.size(); ++i) {
+			if (side_flg[i])
+				local_index_[i] = static_cast<int>(edge_count_++);
+		}
+		incident_bits_.assign(problem.get_width() * problem.get_height(), 0);
+		if (edge_count_ > max_edges)
+			return;
+		for (size_t p = 0; p < incident_bits_.size(); ++p) {
+			for (const auto &dir : problem.get_dir_list1(p)) {
+				incident_bits_[p] |= uint64_t(1) << local_index_[dir.side_index];
+			}
+		}
+	}
+	// 厳密に数えられる盤面か？
+	bool countable() const noexcept {
+		return edge_count_ <= max_edges;
+	}
+	// 途中までの経路の後ろにrouteの地点を付け足し(その時点の得点はscore)、その先の経路を全て数える
+	RouteCount count(const vector<size_t> &route, const int score) const {
+		if (!countable())
+			throw "まだ通れる辺が多すぎて、経路を数えられません。";
+		RouteCount result;
+		// routeを辿る
+		size_t position = problem_.get_start();
+		uint64_t used_bits = 0;
+		for (const auto next_position : route) {
+			for (const auto &dir : problem_.get_dir_list1(position)) {
+				const uint64_t bit = uint64_t(1) << local_index_[dir.side_index];
+				if (dir.next_position == next_position && (used_bits & bit) == 0) {
+					used_bits |= bit;
+					break;
+				}
+			}
+			position = next_position;
+		}
+		// 使った辺の本数ごとに1段ずつ進める
+		vector<StateCount> layer, next_layer;
+		vector<char> visited;
+		vector<size_t> stack;
+		layer.push_back(StateCount{ used_bits, static_cast<uint32_t>(position), score, 1 });
+		while (!layer.empty()) {
+			next_layer.clear();
+			for (const auto &state : layer) {
+				// ゴールなら、ここで止まる経路を数える
+				if (state.position == problem_.get_goal())
+					result.add(state.score, state.count);
+				for (const auto &dir : problem_.get_dir_list1(state.position)) {
+					const uint64_t next_bits = state.used_bits | (uint64_t(1) << local_index_[dir.side_index]);
+					if (next_bits == state.used_bits || !movable(dir.next_position, next_bits))
+						continue;
+					next_layer.push_back(StateCount{ next_bits, dir.next_position, state.score * dir.mul_num + dir.add_num, state.count });
+				}
+			}
+			normalize(next_layer, result.overflow_flg);
+			// ゴールへ行けなくなった状態は捨てる(同じ状態は並んでいるので、判定は1回で済ませる)
+			size_t size = 0;
+			bool reachable_flg = false;
+			for (size_t i = 0; i < next_layer.size(); ++i) {
+				const StateCount &state = next_layer[i];
+				if (i == 0 || state.used_bits != next_layer[i - 1].used_bits || state.position != next_layer[i - 1].position)
+					reachable_flg = reachable(state.position, state.used_bits, visited, stack);
+				if (reachable_flg)
+					next_layer[size++] = state;
+			}
+			next_layer.resize(size);
+			std::swap(layer, next_layer);
+		}
+		return result;
+	}
+	// 経路を全て数える(threadsが2以上なら、部分問題に分けて並列に数える)
+	RouteCount count(const unsigned int threads) const {
+		if (!countable())
+			throw "まだ通れる辺が多すぎて、経路を数えられません。";
+		if (threads <= 1)
+			return count(vector<size_t>(), problem_.get_pre_score());
+		// (部分問題ごとの手間はばらつくので、ワーカーの数より多めに分割する)
+		const auto task_list = Solver().split(problem_, threads * 8, std::numeric_limits<int>::min(), false);
+		ThreadPool pool(threads);
+		vector<std::future<RouteCount>> future_list;
+		for (const auto &task : task_list) {
+			future_list.push_back(pool.enqueue([this, &task] { return count(task.route, task.score); }));
+		}
+		RouteCount result;
+		for (auto &future : future_list) {
+			result.merge(future.get());
+		}
+		return result;
+	}
+	// ランダムな経路をsamples本作り、経路の数を推定する(threads個のワーカーで手分けする)
+	RouteEstimate estimate(const size_t samples, const unsigned int threads, const unsigned int seed) const {
+		const unsigned int workers = std::max(1u, threads);
+		ThreadPool pool(workers);
+		vector<std::future<std::map<int, double>>> future_list;
+		for (unsigned int t = 0; t < workers; ++t) {
+			// (標本は、ワーカーごとにシードを変えて作る)
+			const size_t worker_samples = samples / workers + (t < samples % workers ? 1 : 0);
+			future_list.push_back(pool.enqueue([this, worker_samples, seed, t] {
+				std::map<int, double> histogram;
+				sample(worker_samples, seed + t, histogram);
+				return histogram;
+			}));
+		}
+		RouteEstimate result;
+		result.samples = samples;
+		for (auto &future : future_list) {
+			for (const auto &bin : future.get()) {
+				result.histogram[bin.first] += bin.second;
+			}
+		}
+		for (auto &bin : result.histogram) {
+			bin.second /= static_cast<double>(std::max<size_t>(1, samples));
+		}
+		return result;
+	}
+};
+
+// 問題を解く際の設定(ライブラリ用)
+struct SolveOption {
+	// ワーカースレッドの数(0ならCPUのコア数)
+	unsigned int threads = 1;
+	// ワーカースレッドをCPUコアに固定するか？
+	bool pin_flg = false;
+	// 探索時間の上限(ミリ秒。0なら無制限)。上限に達したら打ち切り、それまでに見つけた解を結果とする
+	unsigned int time_limit = 0;
+	// 残りの辺がこの本数以下になったら、終盤の探索に切り替える(0なら切り替えない)
+	size_t endgame_size = SearchState::default_endgame_size;
+	// 見込みスコアを奇偶で補正するか？
+	bool parity_flg = false;
+	// ベストスコアを更新するたびに呼ばれる処理
+	// (ワーカースレッドから、探索の排他制御をロックしたまま呼ばれるので、手短に済ませること)
+	std::function<void(const Result&, int)> on_improve;
+};
+
+// 探索1回分(ライブラリ用)
+// コンストラクタで探索を始め、wait()で解き終えるのを待ってから、get_best()で結果を受け取る。
+// ・cancel()は別のスレッドからも呼べる。打ち切った場合も、それまでに見つけた解が結果になる
+// ・ワーカースレッドは探索ごとに立て、デストラクタで探索を打ち切ってから止める
+class SolveJob {
+	std::shared_ptr<SearchState> state_;
+	ThreadPool pool_;
+	// 解き終える前に打ち切ったか？(state_->mtxで排他制御する)
+	bool cancel_flg_ = false;
+	// 探索時間の上限に達したら打ち切るスレッド(上限が無ければ作らない)
+	// (呼び出し元が待たずに結果を覗いたり、on_improveだけを頼りにしたりしても、上限で止まるようにする)
+	std::thread timer_;
+	// 設定から、ワーカースレッドの数を決める
+	static unsigned int get_threads(const SolveOption &option) noexcept {
+		return (option.threads != 0 ? option.threads : std::max(1u, std::thread::hardware_concurrency()));
+	}
+public:
+	// コンストラクタ・デストラクタ
+	SolveJob(const Problem &problem, const SolveOption &option)
+		: state_(std::make_shared<SearchState>(problem)), pool_(get_threads(option)) {
+		const auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(option.time_limit);
+		state_->endgame_size = option.endgame_size;
+		state_->parity_flg = option.parity_flg;
+		state_->on_improve = option.on_improve;
+		const unsigned int threads = get_threads(option);
+		Solver().prepare(*state_, threads);
+		Solver::start(pool_, state_, threads, option.pin_flg);
+		if (option.time_limit != 0) {
+			timer_ = std::thread([this, deadline] {
+				if (!state_->wait_for(deadline - std::chrono::steady_clock::now()))
+					cancel();
+			});
+		}
+	}
+	SolveJob(const SolveJob&) = delete;
+	SolveJob& operator=(const SolveJob&) = delete;
+	~SolveJob() {
+		cancel();
+		state_->wait();
+		if (timer_.joinable())
+			timer_.join();
+	}
+	// 探索を打ち切る(既に解き終えていれば何もしない)
+	void cancel() {
+		std::lock_guard<std::mutex> lock(state_->mtx);
+		if (state_->finish_flg)
+			return;
+		cancel_flg_ = true;
+		state_->stop_flg = true;
+	}
+	// 解き終えるまで、最大でtimeoutミリ秒だけ待つ(解き終えていればtrueを返す)
+	bool wait_for(const unsigned int timeout) {
+		return state_->wait_for(std::chrono::milliseconds(timeout));
+	}
+	// 解き終えるまで待つ
+	void wait() {
+		state_->wait();
+	}
+	// 解き終えたか？
+	bool finish_flg() const {
+		std::lock_guard<std::mutex> lock(state_->mtx);
+		return state_->finish_flg;
+	}
+	// 打ち切らずに解き終え、最適解が確定したか？
+	bool optimal_flg() const {
+		std::lock_guard<std::mutex> lock(state_->mtx);
+		return state_->finish_flg && !cancel_flg_;
+	}
+	// 今までに見つけた最も良い解(解が無ければスコアは-9999)
+	std::pair<Result, int> get_best() const {
+		std::lock_guard<std::mutex> lock(state_->mtx);
+		return state_->best;
+	}
+};
+
+#endif
@@ -1,39 +1,68 @@
-﻿#include <algorithm>
-#include <chrono>
-#include <cmath>
-#include <cstdlib>
-#include <fstream>
-#include <iostream>
-#include <numeric>
-#include <sstream>
-#include <string>
-#include <vector>
-#include <mutex>
-#include "ThreadPool.h"
+﻿#include "challerun.h"
+#ifndef _WIN32
+#include <cerrno>
+#include <csignal>
+#include <cstring>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#endif
 
-using std::cout;
-using std::endl;
-using std::ostream;
-using std::string;
-using std::vector;
+// 目標スコアを決めてから探索する際の、最初の目標スコアの決め方
+enum AspirationMode {
+	// 目標スコアを決めない(通常の探索)
+	ASPIRATION_NONE,
+	// 指定した値にする
+	ASPIRATION_VALUE,
+	// 問題ファイルに書かれた既知の最良解の得点にする
+	ASPIRATION_KNOWN,
+	// 短時間の探索で見つけた解の得点と、見込みスコアの中間にする
+	ASPIRATION_AUTO,
+};
 
-class StopWatch {
-	std::chrono::system_clock::time_point start_time;
-	std::chrono::system_clock::time_point end_time;
-public:
-	// ストップウォッチを開始
-	void Start() noexcept{ start_time = std::chrono::system_clock::now(); }
-	// ストップウォッチを停止
-	void Stop() noexcept{ end_time = std::chrono::system_clock::now(); }
-	// 経過時間を返す
-	long long ElapsedNanoseconds() const noexcept {
-		return std::chrono::duration_cast<std::chrono::nanoseconds>(end_time - start_time).count();
-	}
-	long long ElapsedMicroseconds() const noexcept {
-		return std::chrono::duration_cast<std::chrono::microseconds>(end_time - start_time).count();
+// 探索の向き
+enum SearchDirection {
+	// スタートからゴールへ(通常の探索)
+	DIRECTION_FORWARD,
+	// ゴールからスタートへ
+	DIRECTION_BACKWARD,
+	// 両方向の探索木の大きさを推定し、小さい方にする
+	DIRECTION_AUTO,
+};
+
+// 生成モードの設定
+struct GeneratorSetting {
+	// 盤面の幅・高さ
+	size_t width = 0, height = 0;
+	// 演算子(+・-・*の順)を選ぶ割合と、それぞれの数値の範囲(両端を含む)
+	// (既定値は、検証モードで作る盤面と同じく実際の問題に近いもの)
+	int op_rate[3] = { 60, 25, 15 };
+	int min_num[3] = { 1, 1, 2 }, max_num[3] = { 9, 4, 3 };
+	// スタート・ゴールの置き方(地点番号か、corner・opposite・random)
+	string start = "corner", goal = "opposite";
+	// 作る問題の数と、書き出し先のファイル名の接頭辞(空なら標準出力に書き出す)
+	size_t count = 1;
+	string out_prefix;
+	// 較正で目標にする、1問を解く時間(ミリ秒。0なら較正しない)
+	unsigned int calibrate_time = 0;
+	// 「A-B」の形の範囲を読み取る(lowerは最小値の下限)
+	// (+0・-0・*1は何もしない演算子になり、問題文に書き出せないので、+・-は1以上、*は2以上にする)
+	static void parse_range(const string &str, const int lower, int &min_num, int &max_num) {
+		const auto pos = str.find('-', 1);
+		if (pos == string::npos)
+			throw "数値の範囲は「最小値-最大値」の形で指定してください。";
+		min_num = std::stoi(str.substr(0, pos));
+		max_num = std::stoi(str.substr(pos + 1));
+		if (min_num < lower || max_num < min_num)
+			throw "数値の範囲が間違っています(+・-は1以上、*は2以上にしてください)。";
 	}
-	long long ElapsedMilliseconds() const noexcept {
-		return std::chrono::duration_cast<std::chrono::milliseconds>(end_time - start_time).count();
+	// スタート・ゴールの置き方を確かめる(goal_flgがtrueならゴールの置き方)
+	// (地点番号が盤面に収まるかは、盤面の大きさが決まってから調べる)
+	static void check_point_spec(const string &spec, const bool goal_flg) {
+		if (spec == "corner" || spec == "random" || (goal_flg && spec == "opposite"))
+			return;
+		if (spec.empty() || spec.size() > 5 || spec.find_first_not_of("0123456789") != string::npos)
+			throw "スタート・ゴールの置き方は、地点番号かcorner・opposite(ゴールのみ)・randomで指定してください。";
 	}
 };
 
@@ -49,23 +78,317 @@ class Setting {
 	bool solver_flg_ = true;
 	// ソルバーモードの際のスレッド数、分割モードの際の分割数
 	unsigned int split_count_ = 1;
+	// ワーカースレッドをCPUコアに固定するか？
+	bool pin_flg_ = false;
+	// 上位何件の解を出力するか(0なら最適解1つだけ)
+	unsigned int top_count_ = 0;
+	// 最高スコアに並ぶ解を全て出力するか？
+	bool all_optimal_flg_ = false;
+	// スタート・ゴールの候補(空ならスタート地点・ゴール地点の指定に従う)
+	string start_list_, goal_list_;
+	// サーバーモードで動作するか？
+	bool server_flg_ = false;
+	// サーバーモードで待ち受けるUnixドメインソケットのパス(空なら標準入出力を使う)
+	string socket_path_;
+	// 検証モードで試す問題の数(0なら検証モードではない)
+	unsigned int verify_count_ = 0;
+	// 検証モードで使う乱数のシード
+	unsigned int seed_ = 0;
+	// 対話モードで動作するか？
+	bool interactive_flg_ = false;
+	// 分割モードで、見込みスコアがこれ未満の部分問題を捨てる
+	int min_score_ = -9999;
+	// 分割モードで、捨てる基準を短時間の探索で決めるか？
+	bool min_score_auto_flg_ = false;
+	// ジョブファイル名(分割モードでは書き出し先、ソルバーモードでは読み込み元。空なら使わない)
+	string job_file_;
+	// ソルバーモードで解くジョブの範囲(1始まりで両端を含む。0ならジョブファイルの先頭・末尾まで)
+	size_t job_begin_ = 0, job_end_ = 0;
+	// 解のキャッシュのファイル名(空なら使わない)
+	string cache_file_;
+	// トレースの書き出し先のファイル名(空なら記録しない)
+	string trace_file_;
+	// 目標スコアを決めてから探索するか(その場合は最初の目標スコアの決め方)
+	AspirationMode aspiration_mode_ = ASPIRATION_NONE;
+	int aspiration_target_ = 0;
+	// 目標スコアの下げ幅の初期値(0なら、見つかっている解の得点との中間まで下げる)
+	int aspiration_window_ = 0;
+	// ポートフォリオモードで動作するか？
+	bool portfolio_flg_ = false;
+	// ポートフォリオモードの探索設定の一覧(空なら、ワーカーの数に合わせて既定のものを使う)
+	vector<PortfolioConfig> portfolio_list_;
+	// 終盤の探索に切り替える残りの辺の本数(0なら切り替えない。-1なら既定値を使う)
+	int endgame_size_ = -1;
+	// 見込みスコアを奇偶で補正するか？
+	bool parity_flg_ = false;
+	// 探索の向き
+	SearchDirection direction_ = DIRECTION_FORWARD;
+	// 経路を数えるモードで動作するか？
+	bool routes_flg_ = false;
+	// 経路の数を推定する場合の、ランダムな経路の本数(0なら厳密に数える)
+	size_t route_samples_ = 0;
+	// 生成モードで動作するか？(その場合の設定)
+	bool generate_flg_ = false;
+	GeneratorSetting generator_;
+	// 名前付きのオプションを1つ読み取る
+	void parse_option(const string &arg) {
+		if (arg == "--pin") {
+			pin_flg_ = true;
+		}
+		else if (arg.compare(0, 6, "--top=") == 0) {
+			const int top_count = std::stoi(arg.substr(6));
+			if (top_count < 1)
+				throw "--topには1以上の数を指定してください。";
+			top_count_ = top_count;
+		}
+		else if (arg == "--all-optimal") {
+			all_optimal_flg_ = true;
+		}
+		else if (arg.compare(0, 9, "--starts=") == 0) {
+			start_list_ = arg.substr(9);
+		}
+		else if (arg.compare(0, 8, "--goals=") == 0) {
+			goal_list_ = arg.substr(8);
+		}
+		else if (arg.compare(0, 10, "--threads=") == 0) {
+			const int threads = std::stoi(arg.substr(10));
+			if (threads < 1)
+				throw "--threadsには1以上の数を指定してください。";
+			split_count_ = threads;
+		}
+		else if (arg == "--server") {
+			server_flg_ = true;
+		}
+		else if (arg.compare(0, 9, "--server=") == 0) {
+			server_flg_ = true;
+			socket_path_ = arg.substr(9);
+		}
+		else if (arg == "--interactive") {
+			interactive_flg_ = true;
+		}
+		else if (arg.compare(0, 9, "--verify=") == 0) {
+			const int verify_count = std::stoi(arg.substr(9));
+			if (verify_count < 1)
+				throw "--verifyには1以上の数を指定してください。";
+			verify_count_ = verify_count;
+		}
+		else if (arg.compare(0, 7, "--seed=") == 0) {
+			seed_ = static_cast<unsigned int>(std::stoul(arg.substr(7)));
+		}
+		else if (arg == "--min-score=auto") {
+			min_score_auto_flg_ = true;
+		}
+		else if (arg.compare(0, 12, "--min-score=") == 0) {
+			min_score_ = std::stoi(arg.substr(12));
+			min_score_auto_flg_ = false;
+		}
+		else if (arg.compare(0, 8, "--cache=") == 0) {
+			cache_file_ = arg.substr(8);
+		}
+		else if (arg == "--aspiration=known") {
+			aspiration_mode_ = ASPIRATION_KNOWN;
+		}
+		else if (arg == "--aspiration=auto") {
+			aspiration_mode_ = ASPIRATION_AUTO;
+		}
+		else if (arg.compare(0, 13, "--aspiration=") == 0) {
+			aspiration_mode_ = ASPIRATION_VALUE;
+			aspiration_target_ = std::stoi(arg.substr(13));
+		}
+		else if (arg.compare(0, 8, "--trace=") == 0) {
+			trace_file_ = arg.substr(8);
+		}
+		else if (arg == "--portfolio") {
+			portfolio_flg_ = true;
+			portfolio_list_.clear();
+		}
+		else if (arg.compare(0, 12, "--portfolio=") == 0) {
+			portfolio_flg_ = true;
+			portfolio_list_.clear();
+			std::istringstream iss(arg.substr(12));
+			string token;
+			while (std::getline(iss, token, ',')) {
+				portfolio_list_.push_back(PortfolioConfig::parse(token));
+			}
+			if (portfolio_list_.empty())
+				throw "ポートフォリオの探索設定が間違っています。";
+		}
+		else if (arg.compare(0, 20, "--aspiration-window=") == 0) {
+			const int aspiration_window = std::stoi(arg.substr(20));
+			if (aspiration_window < 0)
+				throw "--aspiration-windowには0以上の数を指定してください。";
+			aspiration_window_ = aspiration_window;
+		}
+		else if (arg == "--parity") {
+			parity_flg_ = true;
+		}
+		else if (arg == "--direction=forward") {
+			direction_ = DIRECTION_FORWARD;
+		}
+		else if (arg == "--direction=backward") {
+			direction_ = DIRECTION_BACKWARD;
+		}
+		else if (arg == "--direction=auto") {
+			direction_ = DIRECTION_AUTO;
+		}
+		else if (arg == "--routes") {
+			routes_flg_ = true;
+			route_samples_ = 0;
+		}
+		else if (arg.compare(0, 16, "--routes-sample=") == 0) {
+			const int route_samples = std::stoi(arg.substr(16));
+			if (route_samples < 1)
+				throw "--routes-sampleには1以上の数を指定してください。";
+			routes_flg_ = true;
+			route_samples_ = route_samples;
+		}
+		else if (arg.compare(0, 10, "--endgame=") == 0) {
+			const int endgame_size = std::stoi(arg.substr(10));
+			if (endgame_size < 0 || endgame_size > 24)
+				throw "--endgameには0～24の数を指定してください。";
+			endgame_size_ = endgame_size;
+		}
+		else if (arg.compare(0, 11, "--generate=") == 0) {
+			const string size = arg.substr(11);
+			const auto pos = size.find('x');
+			if (pos == string::npos)
+				throw "--generateは「幅x高さ」の形で指定してください。";
+			const long long width = std::stoi(size.substr(0, pos)), height = std::stoi(size.substr(pos + 1));
+			if (width < 1 || height < 1 || width * height < 2 || width * height > 65535)
+				throw "--generateの盤面の大きさが間違っています。";
+			generate_flg_ = true;
+			generator_.width = width;
+			generator_.height = height;
+		}
+		else if (arg.compare(0, 6, "--ops=") == 0) {
+			std::istringstream iss(arg.substr(6));
+			string token;
+			int sum = 0;
+			for (size_t i = 0; i < 3; ++i) {
+				if (!std::getline(iss, token, ','))
+					throw "--opsには、+・-・*の割合をカンマ区切りで3つ指定してください。";
+				generator_.op_rate[i] = std::stoi(token);
+				if (generator_.op_rate[i] < 0)
+					throw "--opsには0以上の数を指定してください。";
+				sum += generator_.op_rate[i];
+			}
+			if (sum == 0)
+				throw "--opsの割合が全て0です。";
+		}
+		else if (arg.compare(0, 6, "--add=") == 0) {
+			GeneratorSetting::parse_range(arg.substr(6), 1, generator_.min_num[0], generator_.max_num[0]);
+		}
+		else if (arg.compare(0, 6, "--sub=") == 0) {
+			GeneratorSetting::parse_range(arg.substr(6), 1, generator_.min_num[1], generator_.max_num[1]);
+		}
+		else if (arg.compare(0, 6, "--mul=") == 0) {
+			GeneratorSetting::parse_range(arg.substr(6), 2, generator_.min_num[2], generator_.max_num[2]);
+		}
+		else if (arg.compare(0, 11, "--start-at=") == 0) {
+			generator_.start = arg.substr(11);
+			GeneratorSetting::check_point_spec(generator_.start, false);
+		}
+		else if (arg.compare(0, 10, "--goal-at=") == 0) {
+			generator_.goal = arg.substr(10);
+			GeneratorSetting::check_point_spec(generator_.goal, true);
+		}
+		else if (arg.compare(0, 8, "--count=") == 0) {
+			const int count = std::stoi(arg.substr(8));
+			if (count < 1)
+				throw "--countには1以上の数を指定してください。";
+			generator_.count = count;
+		}
+		else if (arg.compare(0, 6, "--out=") == 0) {
+			generator_.out_prefix = arg.substr(6);
+		}
+		else if (arg.compare(0, 12, "--calibrate=") == 0) {
+			const int calibrate_time = std::stoi(arg.substr(12));
+			if (calibrate_time < 1)
+				throw "--calibrateには1以上の数を指定してください。";
+			generator_.calibrate_time = calibrate_time;
+		}
+		else if (arg.compare(0, 7, "--jobs=") == 0) {
+			job_file_ = arg.substr(7);
+		}
+		else if (arg.compare(0, 12, "--job-range=") == 0) {
+			const string range = arg.substr(12);
+			const auto pos = range.find('-');
+			if (pos == string::npos)
+				throw "--job-rangeは「開始番号-終了番号」の形で指定してください。";
+			const int job_begin = std::stoi(range.substr(0, pos)), job_end = std::stoi(range.substr(pos + 1));
+			if (job_begin < 1 || job_end < job_begin)
+				throw "--job-rangeの番号が間違っています。";
+			job_begin_ = job_begin;
+			job_end_ = job_end;
+		}
+		else {
+			throw "不明なオプションです。";
+		}
+	}
 public:
 	// コンストラクタ
 	Setting(int argc, char* argv[]) {
+		// 「--」で始まる引数は名前付きのオプションとして先に取り除いておく
+		vector<string> args;
+		bool threads_flg = false;
+		for (int i = 0; i < argc; ++i) {
+			const string arg = argv[i];
+			if (arg.compare(0, 2, "--") != 0) {
+				args.push_back(arg);
+				continue;
+			}
+			parse_option(arg);
+			if (arg.compare(0, 10, "--threads=") == 0)
+				threads_flg = true;
+		}
+		if (top_count_ != 0 && all_optimal_flg_)
+			throw "--topと--all-optimalは同時に指定できません。";
+		if (interactive_flg_ && (top_count_ != 0 || all_optimal_flg_ || free_flg()))
+			throw "--interactiveは、--top・--all-optimal・--starts・--goalsと同時に指定できません。";
+		// (ジョブファイルは同じ状態をまとめて書き出すので、同点の別経路を全て出すモードには使えない)
+		if (!job_file_.empty() && (top_count_ != 0 || all_optimal_flg_ || free_flg() || interactive_flg_))
+			throw "--jobsは、--top・--all-optimal・--starts・--goals・--interactiveと同時に指定できません。";
+		// (目標スコアを下げながら探索し直すのは、最適解1つだけを求める場合に限る)
+		if (aspiration_mode_ != ASPIRATION_NONE && (!cacheable_flg() || interactive_flg_))
+			throw "--aspirationは、--top・--all-optimal・--starts・--goals・--jobs・--interactiveと同時に指定できません。";
+		if (portfolio_flg_ && (!cacheable_flg() || interactive_flg_ || aspiration_mode_ != ASPIRATION_NONE))
+			throw "--portfolioは、--top・--all-optimal・--starts・--goals・--jobs・--interactive・--aspirationと同時に指定できません。";
+		// (逆向きの探索は、最適解1つだけを求める場合に限る)
+		if (direction_ != DIRECTION_FORWARD && (!cacheable_flg() || interactive_flg_ || aspiration_mode_ != ASPIRATION_NONE || portfolio_flg_))
+			throw "--directionは、--top・--all-optimal・--starts・--goals・--jobs・--interactive・--aspiration・--portfolioと同時に指定できません。";
+		// (経路を数えるモードでは、最適解を探さない)
+		if (routes_flg_ && (top_count_ != 0 || all_optimal_flg_ || free_flg() || !job_file_.empty() || interactive_flg_ || aspiration_mode_ != ASPIRATION_NONE || portfolio_flg_))
+			throw "--routesは、--top・--all-optimal・--starts・--goals・--jobs・--interactive・--aspiration・--portfolioと同時に指定できません。";
+		// 検証モードでは問題ファイル等を指定しない
+		if (verify_count_ != 0)
+			return;
+		// 生成モードでも問題ファイル等を指定しない
+		if (generate_flg_) {
+			if (generator_.count > 1 && generator_.out_prefix.empty())
+				throw "--countが2以上の場合は、--outで書き出し先を指定してください。";
+			return;
+		}
+		// サーバーモードでは問題ファイル等を指定しない
+		// (スレッド数の指定が無ければ、CPUのコア数だけワーカースレッドを立てる)
+		if (server_flg_) {
+			if (!threads_flg)
+				split_count_ = std::max(1u, std::thread::hardware_concurrency());
+			return;
+		}
 		// 引数の数がおかしい場合は例外を投げる
-		if (argc < 4)
+		if (args.size() < 4)
 			throw "引数の数が少なすぎます。";
 		// 問題のファイル名を読み取る
-		file_name_ = argv[1];
+		file_name_ = args[1];
 		// スタート地点を読み取る
-		start_position_ = std::stoi(argv[2]);
+		start_position_ = std::stoi(args[2]);
 		// ゴール地点を読み取る
-		goal_position_ = std::stoi(argv[3]);
+		goal_position_ = std::stoi(args[3]);
 		// オプション部分を読み取る
-		if (argc < 5)
+		if (args.size() < 5)
 			return;
 		{
-			int option = std::stoi(argv[4]);
+			int option = std::stoi(args[4]);
 			if (option != 0) {
 				// ソルバーモード
 				solver_flg_ = true;
@@ -76,954 +399,1507 @@ public:
 			else {
 				// 分割モード
 				solver_flg_ = false;
-				if (argc >= 6) {
-					split_count_ = std::abs(std::stoi(argv[5]));
+				if (args.size() >= 6) {
+					split_count_ = std::abs(std::stoi(args[5]));
 					if (split_count_ <= 1)
 						split_count_ = 2;
 				}
 			}
 		}
 	}
+	// サーバーモードのリクエスト用(名前付きのオプションだけを読み取る)
+	// (スレッド数は、指定が無ければ0とする。これはサーバーの全ワーカースレッドを使うことを表す)
+	explicit Setting(const vector<string> &option_list) {
+		split_count_ = 0;
+		for (const auto &option : option_list) {
+			parse_option(option);
+		}
+		if (top_count_ != 0 && all_optimal_flg_)
+			throw "--topと--all-optimalは同時に指定できません。";
+		if (portfolio_flg_ && !cacheable_flg())
+			throw "--portfolioは、--top・--all-optimal・--starts・--goalsと同時に指定できません。";
+		if (pin_flg_ || server_flg_ || verify_count_ != 0 || generate_flg_ || interactive_flg_ || !job_file_.empty() || !cache_file_.empty() || !trace_file_.empty() || aspiration_mode_ != ASPIRATION_NONE || routes_flg_ || direction_ != DIRECTION_FORWARD)
+			throw "リクエストでは指定できないオプションです。";
+	}
 	// getter
 	string file_name() const noexcept { return file_name_; }
 	int start_position() const noexcept { return start_position_; }
 	int goal_position() const noexcept { return goal_position_; }
 	bool solver_flg() const noexcept { return solver_flg_; }
 	unsigned int split_count() const noexcept { return split_count_; }
+	bool pin_flg() const noexcept { return pin_flg_; }
+	unsigned int top_count() const noexcept { return top_count_; }
+	bool all_optimal_flg() const noexcept { return all_optimal_flg_; }
+	string start_list() const noexcept { return start_list_; }
+	string goal_list() const noexcept { return goal_list_; }
+	// スタート・ゴールを自由に選ぶモードか？
+	bool free_flg() const noexcept { return !start_list_.empty() || !goal_list_.empty(); }
+	bool server_flg() const noexcept { return server_flg_; }
+	string socket_path() const noexcept { return socket_path_; }
+	unsigned int verify_count() const noexcept { return verify_count_; }
+	unsigned int seed() const noexcept { return seed_; }
+	bool interactive_flg() const noexcept { return interactive_flg_; }
+	int min_score() const noexcept { return min_score_; }
+	bool min_score_auto_flg() const noexcept { return min_score_auto_flg_; }
+	string job_file() const noexcept { return job_file_; }
+	size_t job_begin() const noexcept { return job_begin_; }
+	size_t job_end() const noexcept { return job_end_; }
+	string cache_file() const noexcept { return cache_file_; }
+	string trace_file() const noexcept { return trace_file_; }
+	AspirationMode aspiration_mode() const noexcept { return aspiration_mode_; }
+	int aspiration_target() const noexcept { return aspiration_target_; }
+	int aspiration_window() const noexcept { return aspiration_window_; }
+	bool portfolio_flg() const noexcept { return portfolio_flg_; }
+	vector<PortfolioConfig> portfolio_list() const { return portfolio_list_; }
+	int endgame_size() const noexcept { return endgame_size_; }
+	bool parity_flg() const noexcept { return parity_flg_; }
+	SearchDirection direction() const noexcept { return direction_; }
+	bool routes_flg() const noexcept { return routes_flg_; }
+	size_t route_samples() const noexcept { return route_samples_; }
+	bool generate_flg() const noexcept { return generate_flg_; }
+	const GeneratorSetting& generator() const noexcept { return generator_; }
+	// 解のキャッシュを使える(最適解1つだけを求める)モードか？
+	bool cacheable_flg() const noexcept {
+		return top_count_ == 0 && !all_optimal_flg_ && !free_flg() && job_file_.empty();
+	}
 	// 出力用
 	friend ostream& operator << (ostream& os, const Setting& setting) noexcept{
 		os << "【設定】" << endl;
+		if (setting.server_flg_) {
+			os << "・動作モード：サーバーモード" << endl;
+			os << "・待ち受け先：" << (setting.socket_path_.empty() ? "標準入力" : setting.socket_path_) << endl;
+			os << "・動作スレッド数：" << setting.split_count_ << endl;
+			if (!setting.cache_file_.empty())
+				os << "・解のキャッシュ：" << setting.cache_file_ << endl;
+			if (!setting.trace_file_.empty())
+				os << "・トレースの書き出し先：" << setting.trace_file_ << endl;
+			return os;
+		}
 		os << "・ファイル名：" << setting.file_name_ << endl;
 		os << "・スタート地点：" << setting.start_position_ << endl;
 		os << "・ゴール地点：" << setting.goal_position_ << endl;
 		if(setting.solver_flg_){
 			os << "・動作モード：ソルバーモード" << endl;
 			os << "・動作スレッド数：" << setting.split_count_ << endl;
+			os << "・CPUコアへの固定：" << (setting.pin_flg_ ? "する" : "しない") << endl;
+			if (!setting.start_list_.empty())
+				os << "・スタート地点の候補：" << setting.start_list_ << endl;
+			if (!setting.goal_list_.empty())
+				os << "・ゴール地点の候補：" << setting.goal_list_ << endl;
+			if (setting.top_count_ != 0)
+				os << "・出力する解：上位" << setting.top_count_ << "件" << endl;
+			else if (setting.all_optimal_flg_)
+				os << "・出力する解：最高スコアに並ぶ全ての解" << endl;
+			if (setting.interactive_flg_)
+				os << "・対話モード：する" << endl;
+			if (!setting.cache_file_.empty())
+				os << "・解のキャッシュ：" << setting.cache_file_ << endl;
+			if (!setting.trace_file_.empty())
+				os << "・トレースの書き出し先：" << setting.trace_file_ << endl;
+			if (setting.portfolio_flg_) {
+				os << "・ポートフォリオモード：";
+				if (setting.portfolio_list_.empty())
+					os << "既定の探索設定";
+				for (size_t i = 0; i < setting.portfolio_list_.size(); ++i) {
+					os << (i != 0 ? "," : "") << setting.portfolio_list_[i].str();
+				}
+				os << endl;
+			}
+			if (setting.aspiration_mode_ != ASPIRATION_NONE) {
+				os << "・最初の目標スコア：";
+				if (setting.aspiration_mode_ == ASPIRATION_KNOWN)
+					os << "既知の最良解の得点" << endl;
+				else if (setting.aspiration_mode_ == ASPIRATION_AUTO)
+					os << "短時間の探索で決める" << endl;
+				else
+					os << setting.aspiration_target_ << endl;
+				if (setting.aspiration_window_ != 0)
+					os << "・目標スコアの下げ幅：" << setting.aspiration_window_ << "から倍々" << endl;
+				else
+					os << "・目標スコアの下げ幅：見つかっている解との中間まで" << endl;
+			}
+			if (setting.endgame_size_ > 0)
+				os << "・終盤の探索に切り替える残りの辺：" << setting.endgame_size_ << "本" << endl;
+			if (setting.parity_flg_)
+				os << "・見込みスコアの奇偶による補正：する" << endl;
+			if (setting.direction_ == DIRECTION_BACKWARD)
+				os << "・探索の向き：ゴールからスタートへ" << endl;
+			else if (setting.direction_ == DIRECTION_AUTO)
+				os << "・探索の向き：探索木の大きさを推定して決める" << endl;
+			if (setting.routes_flg_) {
+				if (setting.route_samples_ == 0)
+					os << "・経路の数え上げ：厳密に数える" << endl;
+				else
+					os << "・経路の数え上げ：ランダムな経路" << setting.route_samples_ << "本から推定する" << endl;
+			}
+			if (!setting.job_file_.empty()) {
+				os << "・ジョブファイル：" << setting.job_file_ << endl;
+				if (setting.job_begin_ != 0)
+					os << "・解くジョブ：" << setting.job_begin_ << "～" << setting.job_end_ << "番" << endl;
+			}
 		}
 		else {
 			os << "・動作モード：分割モード" << endl;
 			os << "・ファイル分割数：" << setting.split_count_ << endl;
+			if (setting.min_score_auto_flg_)
+				os << "・部分問題を捨てる基準：短時間の探索で決める" << endl;
+			else if (setting.min_score_ != -9999)
+				os << "・部分問題を捨てる基準：見込みスコアが" << setting.min_score_ << "未満" << endl;
+			if (!setting.job_file_.empty())
+				os << "・ジョブファイル：" << setting.job_file_ << endl;
 		}
 		return os;
 	}
 };
 
-// 演算データ
-// 数値を×mul_num＋add_numする役割を担う
-struct Operation {
-	// 掛け算する定数
-	int mul_num = 1;
-	// 足し算する定数
-	int add_num = 0;
-	int add_num_x = 0;	//add_numが1以上ならadd_num、0以下なら0とする
-	// 文字列化
-	string str() const noexcept {
-		if (add_num == 0) {
-			if (mul_num != 1) {
-				return "*" + std::to_string(mul_num);
+// ジョブファイル
+// 分割した部分問題を、盤面のファイル1つを共有する固定長レコードの並びとして保存する
+// (数値は全てリトルエンディアンで、部分問題ごとに盤面を書き出したり読み直したりせずに済む)
+// ・ヘッダ：識別子「CRJB」、版数、盤面の幅・高さ、辺の数、スタート地点、ゴール地点、
+//   1レコードに入る経路の長さ、レコードのバイト数、レコード数(識別子以外は32bit)
+// ・レコード：得点、見込みスコア(32bit)、今いる地点、経路の長さ、経路の各地点(16bit、余りは0で埋める)、
+//   もう使えない辺のビット列(64bit単位)
+const char job_file_magic[4] = { 'C', 'R', 'J', 'B' };
+const uint32_t job_file_version = 1;
+const size_t job_file_header_size = 4 + 4 * 9;
+template<class T>
+void write_le(ostream &os, const T value) {
+	char buffer[sizeof(T)];
+	for (size_t i = 0; i < sizeof(T); ++i) {
+		buffer[i] = static_cast<char>((static_cast<uint64_t>(value) >> (i * 8)) & 0xFF);
+	}
+	os.write(buffer, sizeof(T));
+}
+template<class T>
+T read_le(std::istream &is) {
+	unsigned char buffer[sizeof(T)];
+	if (!is.read(reinterpret_cast<char*>(buffer), sizeof(T)))
+		throw "ジョブファイルが途中で途切れています。";
+	uint64_t value = 0;
+	for (size_t i = 0; i < sizeof(T); ++i) {
+		value |= static_cast<uint64_t>(buffer[i]) << (i * 8);
+	}
+	return static_cast<T>(value);
+}
+// 途中までの経路の後ろにrouteを付け足した際の、もう使えない辺のビット列を返す(scoreには得点が入る)
+vector<uint64_t> get_unusable_side_bits(const Problem &problem, const vector<size_t> &route, int &score) {
+	vector<int> side_flg = problem.get_side_flg();
+	score = problem.get_pre_score();
+	size_t position = problem.get_start();
+	for (const auto next_position : route) {
+		bool move_flg = false;
+		for (const auto &dir : problem.get_dir_list(position)) {
+			if (dir.next_position != next_position || !side_flg[dir.side_index])
+				continue;
+			side_flg[dir.side_index] = 0;
+			score = problem.get_operation(dir.side_index).calc(score);
+			move_flg = true;
+			break;
+		}
+		if (!move_flg)
+			throw "ジョブの経路が盤面と一致しません。";
+		position = next_position;
+	}
+	vector<uint64_t> side_bits((side_flg.size() + 63) / 64, 0);
+	for (size_t i = 0; i < side_flg.size(); ++i) {
+		if (!side_flg[i])
+			side_bits[i / 64] |= uint64_t(1) << (i % 64);
+	}
+	return side_bits;
+}
+// 部分問題の一覧をジョブファイルに書き出す
+void write_job_file(const string &file_name, const Problem &problem, const vector<SplitTask> &split_list) {
+	if (problem.get_width() * problem.get_height() > 0xFFFF)
+		throw "盤面が大きすぎるため、ジョブファイルに書き出せません。";
+	size_t route_capacity = 0;
+	for (const auto &task : split_list) {
+		route_capacity = std::max(route_capacity, task.route.size());
+	}
+	const size_t side_words = (problem.side_size() + 63) / 64;
+	const size_t record_size = 4 * 2 + 2 * 2 + 2 * route_capacity + 8 * side_words;
+	std::ofstream ofs(file_name, std::ios::binary);
+	if (!ofs)
+		throw "ジョブファイルを作成できませんでした。";
+	ofs.write(job_file_magic, sizeof(job_file_magic));
+	write_le<uint32_t>(ofs, job_file_version);
+	write_le<uint32_t>(ofs, problem.get_width());
+	write_le<uint32_t>(ofs, problem.get_height());
+	write_le<uint32_t>(ofs, problem.side_size());
+	write_le<uint32_t>(ofs, problem.get_start());
+	write_le<uint32_t>(ofs, problem.get_goal());
+	write_le<uint32_t>(ofs, route_capacity);
+	write_le<uint32_t>(ofs, record_size);
+	write_le<uint32_t>(ofs, split_list.size());
+	for (const auto &task : split_list) {
+		int score;
+		const auto side_bits = get_unusable_side_bits(problem, task.route, score);
+		write_le<int32_t>(ofs, task.score);
+		write_le<int32_t>(ofs, task.upper_score);
+		write_le<uint16_t>(ofs, task.route.empty() ? problem.get_start() : task.route.back());
+		write_le<uint16_t>(ofs, task.route.size());
+		for (size_t i = 0; i < route_capacity; ++i) {
+			write_le<uint16_t>(ofs, i < task.route.size() ? task.route[i] : 0);
+		}
+		for (const auto word : side_bits) {
+			write_le<uint64_t>(ofs, word);
+		}
+	}
+	if (!ofs)
+		throw "ジョブファイルの書き出しに失敗しました。";
+}
+// ジョブファイルから、job_begin～job_end番(1始まりで両端を含む。0なら先頭・末尾まで)の部分問題を読み込む
+// (各レコードの経路は盤面と突き合わせ、得点・今いる地点・使えない辺が一致することを確かめる)
+vector<SplitTask> read_job_file(const string &file_name, const Problem &problem, size_t job_begin, size_t job_end) {
+	std::ifstream ifs(file_name, std::ios::binary);
+	if (!ifs)
+		throw "ジョブファイルを開けませんでした。";
+	char magic[sizeof(job_file_magic)];
+	if (!ifs.read(magic, sizeof(magic)) || !std::equal(magic, magic + sizeof(magic), job_file_magic) || read_le<uint32_t>(ifs) != job_file_version)
+		throw "ジョブファイルとして解釈できませんでした。";
+	const size_t width = read_le<uint32_t>(ifs), height = read_le<uint32_t>(ifs), side_size = read_le<uint32_t>(ifs);
+	const size_t start = read_le<uint32_t>(ifs), goal = read_le<uint32_t>(ifs);
+	if (width != problem.get_width() || height != problem.get_height() || side_size != problem.side_size()
+		|| start != problem.get_start() || goal != problem.get_goal())
+		throw "ジョブファイルと問題ファイルの盤面・スタート・ゴールが一致しません。";
+	const size_t route_capacity = read_le<uint32_t>(ifs), record_size = read_le<uint32_t>(ifs), record_count = read_le<uint32_t>(ifs);
+	const size_t side_words = (side_size + 63) / 64;
+	if (record_size != 4 * 2 + 2 * 2 + 2 * route_capacity + 8 * side_words)
+		throw "ジョブファイルとして解釈できませんでした。";
+	if (job_begin == 0)
+		job_begin = 1;
+	if (job_end == 0 || job_end > record_count)
+		job_end = record_count;
+	vector<SplitTask> split_list;
+	if (job_begin > job_end)
+		return split_list;
+	// 必要なレコードの位置まで読み飛ばす
+	ifs.seekg(job_file_header_size + (job_begin - 1) * record_size);
+	for (size_t index = job_begin; index <= job_end; ++index) {
+		SplitTask task;
+		task.score = read_le<int32_t>(ifs);
+		task.upper_score = read_le<int32_t>(ifs);
+		const size_t position = read_le<uint16_t>(ifs), route_size = read_le<uint16_t>(ifs);
+		if (route_size > route_capacity)
+			throw "ジョブファイルとして解釈できませんでした。";
+		for (size_t i = 0; i < route_capacity; ++i) {
+			const size_t point = read_le<uint16_t>(ifs);
+			if (i < route_size)
+				task.route.push_back(point);
+		}
+		vector<uint64_t> side_bits(side_words);
+		for (auto &word : side_bits) {
+			word = read_le<uint64_t>(ifs);
+		}
+		int score;
+		if (get_unusable_side_bits(problem, task.route, score) != side_bits || score != task.score
+			|| position != (task.route.empty() ? problem.get_start() : task.route.back()))
+			throw "ジョブの経路が盤面と一致しません。";
+		split_list.push_back(std::move(task));
+	}
+	return split_list;
+}
+
+// 動作設定に従って、探索1回分の状態を用意する(threadsは部分問題を解くワーカーの数)
+std::shared_ptr<SearchState> make_search_state(const Problem &problem, const Setting &setting, const unsigned int threads) {
+	auto state = std::make_shared<SearchState>(problem, setting.top_count(), setting.all_optimal_flg());
+	if (setting.endgame_size() >= 0)
+		state->endgame_size = setting.endgame_size();
+	state->parity_flg = setting.parity_flg();
+	Solver solver;
+	if (setting.free_flg()) {
+		// スタート・ゴールを自由に選ぶ
+		// (候補が指定されていない側は、通常通りの地点を使う)
+		const auto start_list = (setting.start_list().empty() ? vector<size_t>(1, problem.get_start()) : problem.get_point_list(setting.start_list()));
+		const auto goal_list = (setting.goal_list().empty() ? vector<size_t>(1, problem.get_goal()) : problem.get_point_list(setting.goal_list()));
+		solver.prepare_free(*state, start_list, goal_list);
+	}
+	else if (setting.portfolio_flg()) {
+		// ワーカーごとに探索設定を変えて、問題全体を解く
+		// (探索設定の指定が無ければ、ワーカーの数だけ既定のものを使う)
+		const auto config_list = setting.portfolio_list();
+		solver.prepare_portfolio(*state, (config_list.empty() ? PortfolioConfig::get_default_list(threads) : config_list));
+	}
+	else if (!setting.job_file().empty()) {
+		// ジョブファイルの部分問題を解く
+		solver.prepare(*state, read_job_file(setting.job_file(), problem, setting.job_begin(), setting.job_end()));
+	}
+	else {
+		solver.prepare(*state, threads);
+	}
+	return state;
+}
+
+// 解のキャッシュ
+// 盤面・スタート・ゴール・途中までの経路が同じ問題の結果を、ファイルに1行ずつ追記して保存する。
+// 各行は「<キー(16進)> <種類> <スコア> <経路の長さ> <地点番号...>」で、経路は途中までの経路より後ろの部分。種類は
+// ・optimal：最適解が確定したもの(キャッシュにあれば、探索せずにそれを返す)
+// ・bound：探索を途中で打ち切った際に見つかっていた解(次の探索の初期のベストスコアにする)
+// キーは問題を保存用に書き出した文字列のハッシュ値なので、読み込んだ経路は盤面と突き合わせ、合わなければ無視する。
+// (ファイルは起動時に全て読み込み、以降は追記だけを行う。複数のプロセスで共有しても、壊れるのは書きかけの行だけになる)
+class SolutionCache {
+	struct Entry {
+		bool optimal_flg;
+		int score;
+		vector<size_t> route;
+	};
+	string file_name_;
+	std::mutex mtx_;
+	std::map<uint64_t, Entry> entry_list_;
+	// 同じキーについては、最適解が確定したもの(複数あれば後から書いたもの)、無ければスコアが最も高いものを残す
+	void insert(const uint64_t key, Entry entry) {
+		const auto it = entry_list_.find(key);
+		if (it != entry_list_.end() && !entry.optimal_flg && (it->second.optimal_flg || it->second.score >= entry.score))
+			return;
+		entry_list_[key] = std::move(entry);
+	}
+public:
+	// コンストラクタ
+	// (ファイルがまだ無い場合は、空のキャッシュとして扱う)
+	explicit SolutionCache(const string &file_name) : file_name_(file_name) {
+		std::ifstream ifs(file_name_);
+		string line;
+		while (std::getline(ifs, line)) {
+			std::istringstream iss(line);
+			string key, kind;
+			Entry entry;
+			size_t route_size;
+			if (!(iss >> key >> kind >> entry.score >> route_size) || (kind != "optimal" && kind != "bound"))
+				continue;
+			entry.optimal_flg = (kind == "optimal");
+			size_t point;
+			while (entry.route.size() < route_size && iss >> point) {
+				entry.route.push_back(point);
 			}
-			else {
-				return "";
+			if (entry.route.size() != route_size)
+				continue;
+			insert(std::stoull(key, nullptr, 16), std::move(entry));
+		}
+	}
+	// 問題のキー(保存用に書き出した文字列の、64bit FNV-1aハッシュ値)
+	static uint64_t get_key(const Problem &problem) {
+		uint64_t hash = 14695981039346656037ULL;
+		for (const unsigned char c : problem.to_file()) {
+			hash = (hash ^ c) * 1099511628211ULL;
+		}
+		return hash;
+	}
+	// 問題の結果を探す
+	// 見つかればtrueを返し、optimal_flgに最適解が確定しているか、bestに(経路, スコア)を入れる
+	bool find(const Problem &problem, bool &optimal_flg, std::pair<Result, int> &best) {
+		std::lock_guard<std::mutex> lock(mtx_);
+		const auto it = entry_list_.find(get_key(problem));
+		if (it == entry_list_.end())
+			return false;
+		const Entry &entry = it->second;
+		Result result(problem);
+		try {
+			// (経路が無い場合は、スコアが-9999(解無し)であること)
+			int score = -9999;
+			if (!entry.route.empty()) {
+				get_unusable_side_bits(problem, entry.route, score);
+				if (entry.route.back() != problem.get_goal())
+					return false;
+			}
+			else if (problem.get_start() == problem.get_goal()) {
+				score = problem.get_pre_score();
 			}
+			if (score != entry.score)
+				return false;
 		}
-		else if (add_num > 0) {
-			return "+" + std::to_string(add_num);
+		catch (const char*) {
+			return false;
 		}
-		else {
-			return "-" + std::to_string(std::abs(add_num));
+		size_t position = problem.get_start();
+		for (const auto next_position : entry.route) {
+			result.move_side(get_step_code(position, next_position, problem.get_width()));
+			position = next_position;
 		}
+		optimal_flg = entry.optimal_flg;
+		best = std::pair<Result, int>(result, entry.score);
+		return true;
 	}
-	// 計算を適用
-	inline int calc(const int x) const noexcept {
-		return x * mul_num + add_num;
+	// 問題の結果を保存する
+	void store(const Problem &problem, const bool optimal_flg, const std::pair<Result, int> &best) {
+		Entry entry{ optimal_flg, best.second, vector<size_t>() };
+		if (best.second != -9999) {
+			const auto root = best.first.get_root();
+			entry.route.assign(root.begin() + problem.get_pre_root().size(), root.end());
+		}
+		const uint64_t key = get_key(problem);
+		std::ostringstream oss;
+		oss << std::hex << key << std::dec << " " << (optimal_flg ? "optimal" : "bound") << " " << entry.score << " " << entry.route.size();
+		for (const auto point : entry.route) {
+			oss << " " << point;
+		}
+		oss << endl;
+		std::lock_guard<std::mutex> lock(mtx_);
+		insert(key, std::move(entry));
+		std::ofstream ofs(file_name_, std::ios::app);
+		ofs << oss.str() << std::flush;
 	}
-	// 2つのOperationを合体させる(非可換)
-	// 「Operation1 + Operation2」を、「Operation1の後にOperation2を適用する」といった意味とする
-	const Operation operator + (const Operation& b) const {
-		// Operation1をM1*X+A1、Operation2をM2*X+A2とする。
-		// Operation1→Operation2の順で適用すると、
-		// M2*(M1*X+A1)+A2=M1*M2*X+A1*M2+A2 となる
-		const int mul_num2 = this->mul_num * b.mul_num;
-		const int add_num2 = this->add_num * b.mul_num + b.add_num;
-		return Operation{ mul_num2, add_num2, (add_num2 > 0 ? add_num2 : 0) };
+	// キャッシュにある結果を、探索の状態stateに反映させる
+	// (最適解が確定していれば、解き終えた状態にしてtrueを返す。そうでなければ初期のベストスコアにする)
+	bool apply(SearchState &state) {
+		bool optimal_flg;
+		std::pair<Result, int> best;
+		if (!find(state.problem, optimal_flg, best))
+			return false;
+		if (state.best.second < best.second) {
+			state.best = best;
+			state.best_score = best.second;
+		}
+		if (!optimal_flg && state.best.second < state.upper_score)
+			return false;
+		state.finish_flg = true;
+		return true;
 	}
 };
-// 方向データ
-struct Direction {
-	// 行き先
-	size_t next_position;
-	// 辺の番号
-	size_t side_index;
-	// 辺の情報
-	Operation operation;
-};
-struct Direction2 {
-	// 行き先
-	size_t next_position1, next_position2;
-	// 辺の番号
-	size_t side_index1, side_index2;
-	// 辺の情報
-	Operation operation;
-};
 
-// 問題データ
-class Problem {
-	// 頂点データ
-	// field_[マス目][各方向] = 方向データ
-	// [各方向]部分を可変長(vector)にしているのがポイント
-	vector<vector<Direction>> field_;
-	//頂点データ(2歩編)
-	vector<vector<Direction2>> field2_;
-	// 辺データ
-	vector<Operation> side_;
-	// 盤面サイズ
-	size_t width_ = 0, height_ = 0;
-	// スタート・ゴール
-	size_t start_, goal_;
-	// 既存の経路
-	// 例えば<途中までの経路>が「1 0 8」だとスタート0・ゴール8・既存の経路「0」だが、
-	// 「4 0 3 6 7 8」だとスタート7・ゴール8・既存の経路「0→3→6→7」になる
-	vector<size_t> pre_root_;
-	// 既存の得点
-	// 起点における所持得点は1点だが、既存の経路に従って移動すると当然得点が変化する
-	int pre_score_ = 1;
-	// 地点A→地点Bに移動する際のインデックスを取得する
-	// 取得できない場合は-1を返す
-	int get_index(const size_t point_a, const size_t point_b)const noexcept{
-		int result = -1;
-		for (size_t i = 0; i < field_[point_a].size(); ++i) {
-			if (field_[point_a][i].next_position == point_b) {
-				result = static_cast<int>(i);
-				break;
-			}
+// 分割モードで、見込みスコアがこれ未満の部分問題を捨てる、という基準を返す
+// (「--min-score=auto」の場合は、probe_searchの時点のベストスコアを基準とする。
+//   それ以上の解は、基準以上の見込みスコアを持つ部分問題のどれかに必ず含まれる)
+// cacheがnullptrでなければ、キャッシュにある解を探索の起点にし、探索結果(打ち切った場合はその時点の解)を保存する
+int get_min_score(const Problem &problem, const Setting &setting, SolutionCache *cache) {
+	if (!setting.min_score_auto_flg())
+		return setting.min_score();
+	const auto state = std::make_shared<SearchState>(problem);
+	if (cache != nullptr && cache->apply(*state))
+		return state->best_score;
+	const bool optimal_flg = probe_search(state);
+	if (cache != nullptr)
+		cache->store(problem, optimal_flg, state->best);
+	return state->best_score;
+}
+
+// 設定に従って、目標スコアを決めてから探索する際の最初の目標スコアを返す
+// (「--aspiration=auto」の場合は、probe_searchで見つけた解の得点と見込みスコアの中間とし、見つけた解はstate->bestに入れる。
+//   probe_searchで解き終えた場合は、stateを解き終えた状態にする)
+int get_aspiration_target(const std::shared_ptr<SearchState> &state, const Setting &setting) {
+	const Problem &problem = state->problem;
+	if (setting.aspiration_mode() == ASPIRATION_KNOWN) {
+		if (problem.get_known_score() == -9999)
+			throw "問題ファイルに既知の最良解が書かれていません。";
+		return problem.get_known_score();
+	}
+	if (setting.aspiration_mode() != ASPIRATION_AUTO)
+		return setting.aspiration_target();
+	const auto probe_state = std::make_shared<SearchState>(problem);
+	probe_state->best = state->best;
+	probe_state->best_score = state->best_score;
+	const bool optimal_flg = probe_search(probe_state);
+	state->best = probe_state->best;
+	state->best_score = state->best.second;
+	if (optimal_flg)
+		state->finish_flg = true;
+	return static_cast<int>((static_cast<int64_t>(state->best.second) + state->upper_score) / 2);
+}
+
+// 逆向きに探索するか？
+// (「--direction=auto」の場合は、両方向の探索木の大きさを推定し、逆向きの方が小さければ逆向きにする。
+//   まず枝刈りせずに推定しながら解を拾い、拾えた最も良い解の得点で枝刈りした探索木の大きさを比べる。推定の結果は標準エラー出力に出す)
+bool is_backward_search(const Problem &problem, const Setting &setting) {
+	const size_t samples = 2000;
+	if (setting.direction() != DIRECTION_AUTO)
+		return (setting.direction() == DIRECTION_BACKWARD);
+	int forward_score, backward_score;
+	estimate_tree_size(problem, false, samples, setting.seed(), -9999, forward_score);
+	estimate_tree_size(problem, true, samples, setting.seed(), -9999, backward_score);
+	const int threshold = std::max(forward_score, backward_score);
+	int found_score;
+	const double forward_size = estimate_tree_size(problem, false, samples, setting.seed() + 1, threshold, found_score);
+	const double backward_size = estimate_tree_size(problem, true, samples, setting.seed() + 1, threshold, found_score);
+	const bool backward_flg = (backward_size < forward_size);
+	std::cerr << "探索の向き：" << (backward_flg ? "逆向き" : "順向き") << "(得点" << threshold << "以上の解を探す探索木の大きさの推定値は、順向き"
+		<< forward_size << "、逆向き" << backward_size << ")" << endl;
+	return backward_flg;
+}
+
+// 解を、スコアの高い順に1行ずつ出力する(各行の先頭にはprefixを付ける)
+// (スタート・ゴールを自由に選ぶモードでは、末尾にスタート地点とゴール地点を付け加える)
+void write_result(ostream &os, const SearchState &state, const StopWatch &sw, const string &prefix) {
+	for (const auto &output : state.get_output_list()) {
+		os << prefix << state.problem.get_width() << "," << state.problem.get_height() << "," << output.first << "," << output.second << "," << (1.0 * sw.ElapsedMilliseconds() / 1000);
+		if (state.free_flg()) {
+			const auto root = output.second.get_root();
+			os << "," << root.front() << "," << root.back();
+		}
+		os << endl;
+	}
+}
+
+// 経路の数と、スコアごとの経路の数を出力する
+// (推定する場合は、数が実数になる)
+void count_routes(ostream &os, const Problem &problem, const Setting &setting) {
+	StopWatch sw;
+	sw.Start();
+	const RouteCounter counter(problem);
+	if (setting.route_samples() == 0) {
+		RouteCount result;
+		try {
+			result = counter.count(setting.split_count());
+		}
+		catch (const std::bad_alloc&) {
+			throw "メモリが足りず、経路を数えきれませんでした。--routes-sampleで推定してください。";
+		}
+		sw.Stop();
+		os << "経路の数：" << result.total() << "(" << (1.0 * sw.ElapsedMilliseconds() / 1000) << "秒)" << endl;
+		if (result.overflow_flg)
+			os << "※経路の数が64bitに収まらなかったため、数は正しくありません。" << endl;
+		os << "スコア,経路の数" << endl;
+		for (const auto &bin : result.histogram) {
+			os << bin.first << "," << bin.second << endl;
 		}
-		return result;
 	}
-	void erase_root(const size_t point_a, const size_t point_b) {
-		const int index_ab = get_index(point_a, point_b);
-		const int index_ba = get_index(point_b, point_a);
-		if(index_ab >= 0)
-			field_[point_a].erase(field_[point_a].begin() + index_ab);
-		if (index_ba >= 0)
-		field_[point_b].erase(field_[point_b].begin() + index_ba);
+	else {
+		const auto result = counter.estimate(setting.route_samples(), setting.split_count(), setting.seed());
+		sw.Stop();
+		os << "経路の数(推定)：" << result.total() << "(ランダムな経路" << result.samples << "本から推定、" << (1.0 * sw.ElapsedMilliseconds() / 1000) << "秒)" << endl;
+		os << "スコア,経路の数(推定)" << endl;
+		for (const auto &bin : result.histogram) {
+			os << bin.first << "," << bin.second << endl;
+		}
+	}
+}
+
+#ifndef _WIN32
+// ソケットの接続1本分
+// (結果の送信はワーカースレッドから行われるので、排他制御する)
+class Connection {
+	int fd_;
+	std::mutex mtx_;
+public:
+	// コンストラクタ・デストラクタ
+	explicit Connection(const int fd) : fd_(fd) {}
+	~Connection() { ::close(fd_); }
+	Connection(const Connection&) = delete;
+	Connection& operator=(const Connection&) = delete;
+	// 文字列を送信する(相手が切断していた場合は何もしない)
+	void send(const string &str) {
+		std::lock_guard<std::mutex> lock(mtx_);
+		size_t offset = 0;
+		while (offset < str.size()) {
+			const ssize_t size = ::write(fd_, str.data() + offset, str.size() - offset);
+			if (size <= 0)
+				return;
+			offset += size;
+		}
+	}
+	// getter
+	int fd() const noexcept { return fd_; }
+};
+
+// ファイルディスクリプタから読み込むためのstreambuf
+// (ソケットからの入力を、標準入力と同じくistreamとして扱うために使う)
+class FdStreamBuf : public std::streambuf {
+	int fd_;
+	char buffer_[4096];
+protected:
+	int_type underflow() override {
+		if (gptr() < egptr())
+			return traits_type::to_int_type(*gptr());
+		ssize_t size;
+		do {
+			size = ::read(fd_, buffer_, sizeof(buffer_));
+		} while (size < 0 && errno == EINTR);
+		if (size <= 0)
+			return traits_type::eof();
+		setg(buffer_, buffer_, buffer_ + size);
+		return traits_type::to_int_type(*gptr());
 	}
 public:
 	// コンストラクタ
-	Problem(){}
-	Problem(const string file_name, const int start_position, const int goal_position) {
+	explicit FdStreamBuf(const int fd) : fd_(fd) {}
+};
+#endif
+
+// サーバーモード
+// ワーカースレッドを起動したままにして、標準入力かUnixドメインソケットからリクエストを受け付ける
+// (1回ごとにプロセスを起動する場合と比べて、プロセスの起動やスレッドの作成にかかる時間を省ける)
+// ・リクエストは、1行のヘッダと、それに続くちょうど<バイト数>バイトの問題文(format.txtの形式)からなる
+//     solve <ID> <スタート地点> <ゴール地点> <バイト数> [--threads=N] [--top=K] [--all-optimal] [--starts=候補] [--goals=候補]
+//   「quit」を送ると、その入力からの受け付けを終える
+// ・レスポンスは、通常の出力の各行の先頭に「<ID>,」を付けたものと、最後の「<ID>,end」の行からなる
+//   (時間の欄は、リクエストを受け取ってから結果が出るまでの時間になる)
+//   エラーの場合は「<ID>,error,<メッセージ>」の1行だけを返す
+// ・複数のリクエストを同時に受け付け、全てのリクエストで同じワーカースレッドを共有する
+//   (レスポンスは、解き終えた順に返る)
+class Server {
+	// ワーカースレッドの数
+	unsigned int threads_;
+	// ワーカースレッドをCPUコアに固定するか？
+	bool pin_flg_;
+	ThreadPool pool_;
+	// 解のキャッシュ(使わない場合はnullptr)
+	std::unique_ptr<SolutionCache> cache_;
+	// 処理中のリクエストの数
+	std::mutex mtx_;
+	size_t running_count_ = 0;
+	std::condition_variable idle_cv_;
+	// リクエストを1件処理し始める
+	void start_request(const vector<string> &token_list, std::istream &is, const std::function<void(const string&)> &send) {
+		// リクエストを受け取った時点から時間を計る
+		StopWatch sw;
+		sw.Start();
+		const string id = (token_list.size() >= 2 ? token_list[1] : "");
+		std::shared_ptr<SearchState> state;
+		unsigned int threads = threads_;
+		bool cache_flg = true;
 		try {
-			// ファイルを読み込む
-			std::ifstream ifs(file_name);
-			if (ifs.fail())
-				throw "ファイルを読み込めません。";
-			// 盤面サイズを読み込む
-			{
-				int width__, height__;
-				ifs >> width__ >> height__;
-				if (width__ < 1 || height__ < 1)
-					throw "盤面サイズが間違っています。";
-				width_ = width__;
-				height_ = height__;
-			}
-			field_.resize(width_ * height_, vector<Direction>());
-			start_ = (start_position >= 0 && start_position < width_ * height_ ? start_position : 0);
-			goal_ = (goal_position >= 0 && goal_position < width_ * height_ ? goal_position : width_ * height_ - 1);
-			// 盤面を読み込む
-			for (size_t h = 0; h < height_ * 2 - 1; ++h) {
-				for (size_t w = 0; w < (h % 2 == 0 ? width_ - 1 : width_); ++w) {
-					if (ifs.eof())
-						throw "盤面データが足りません。";
-					// 一区切り(+1や-3や*7など)を読み込む
-					string token;
-					ifs >> token;
-					// 2文字目以降を数字と認識する
-					const int number = std::stoi(token.substr(1));
-					// 演算子を読み取り、それによって場合分けを行う
-					const string operation_str = token.substr(0, 1);
-					Operation ope;
-					if (operation_str == "+") {
-						ope.add_num = number;
-						ope.add_num_x = std::max(0, number);
-					}
-					else if (operation_str == "-") {
-						ope.add_num = -number;
-						ope.add_num_x = std::max(0, -number);
-					}
-					else if (operation_str == "*") {
-						ope.mul_num = number;
-					}
-					else {
-						throw "不明な演算子です。";
-					}
-					// field_およびsideに代入する
-					if (h % 2 == 0) {
-						{
-							// 横方向の経路─
-							size_t x = w;
-							size_t y = h / 2;
-							size_t p = y * width_ + x;
-							field_[p].push_back(Direction{ p + 1, side_.size(), ope });
-							field_[p + 1].push_back(Direction{ p, side_.size(), ope });
-						}
-					}
-					else {
-						{
-							// 縦方向の経路│
-							size_t x = w;
-							size_t y = (h - 1) / 2;
-							size_t p = y * width_ + x;
-							field_[p].push_back(Direction{ p + width_, side_.size(), ope });
-							field_[p + width_].push_back(Direction{ p, side_.size(), ope });
-						}
-					}
-					side_.push_back(ope);
-				}
-			}
-			// スタート・移動経路・ゴールを読み込む
-			if (ifs.eof()) {
-				pre_root_.push_back(start_);
-				return;
+			try {
+				if (token_list[0] != "solve" || token_list.size() < 5)
+					throw "リクエストの形式が間違っています。";
+				const int start_position = std::stoi(token_list[2]);
+				const int goal_position = std::stoi(token_list[3]);
+				const int body_size = std::stoi(token_list[4]);
+				if (body_size < 0)
+					throw "リクエストの形式が間違っています。";
+				string body(body_size, '\0');
+				if (body_size > 0 && !is.read(&body[0], body_size))
+					throw "問題文が途中で途切れています。";
+				std::istringstream body_stream(body);
+				const Problem problem(body_stream, start_position, goal_position);
+				const Setting setting(vector<string>(token_list.begin() + 5, token_list.end()));
+				if (setting.split_count() != 0)
+					threads = std::min(threads, setting.split_count());
+				state = make_search_state(problem, setting, threads);
+				if (!cache_ || !setting.cacheable_flg())
+					cache_flg = false;
 			}
-			{
-				int pre_root_size;
-				ifs >> pre_root_size;
-				if (pre_root_size < 0) {
-					pre_root_.push_back(start_);
-					return;
-				}
-				for (size_t i = 0; i < pre_root_size; ++i) {
-					int pre_root_pos;
-					ifs >> pre_root_pos;
-					if (pre_root_pos < 0)
-						throw "途中までの経路データが間違っています。";
-					pre_root_.push_back(pre_root_pos);
-				}
-				int pre_root_goal;
-				ifs >> pre_root_goal;
-				if (pre_root_goal < 0)
-					throw "途中までの経路データが間違っています。";
-				start_ = pre_root_[pre_root_size - 1];
-				goal_ = pre_root_goal;
+			catch (const char *s) {
+				throw s;
 			}
-			// 読み取った移動経路に従い、問題を最適化
-			if (pre_root_.size() > 1) {
-				// 移動経路における演算を行い、同時にその演算子を削除
-				for (size_t i = 0; i < pre_root_.size() - 1; ++i) {
-					// 移動時の始点と終点を取得する
-					size_t pos_src = pre_root_[i];
-					size_t pos_dst = pre_root_[i + 1];
-					const int index_sd = get_index(pos_src, pos_dst);
-					// 演算子を利用した演算を行う
-					const auto &ope = side_[field_[pos_src][index_sd].side_index];
-					pre_score_ = ope.calc(pre_score_);
-					// 演算に使用した部分を削除する
-					erase_root(pos_src, pos_dst);
-				}
-				// 移動後に生じた「使用できない演算子」を削除して回る
-				bool erease_flg;
-				do {
-					erease_flg = false;
-					for (size_t y = 0; y < height_; ++y) {
-						for (size_t x = 0; x < width_; ++x) {
-							size_t pos_src = y * width_ + x;
-							if (field_[pos_src].size() == 1 && pos_src != start_ && pos_src != goal_) {
-								size_t pos_dst = field_[pos_src][0].next_position;
-								erase_root(pos_src, pos_dst);
-								erease_flg = true;
-								break;
-							}
-						}
-						if (erease_flg)
-							break;
-					}
-				} while (erease_flg);
-			}
-			// field2_を作成する
-			field2_.resize(width_ * height_, vector<Direction2>());
-			for (size_t p = 0; p < width_ * height_; ++p) {
-				for (const auto &next1 : field_[p]) {
-					for (const auto &next2 : field_[next1.next_position]) {
-						if (next2.next_position == p)
-							continue;
-						const auto &next_position1 = next1.next_position;
-						const auto &next_position2 = next2.next_position;
-						const auto &side_index1 = next1.side_index;
-						const auto &side_index2 = next2.side_index;
-						const Operation operation = next1.operation + next2.operation;
-						Direction2 dir2 = { next_position1, next_position2 , side_index1, side_index2, operation };
-						field2_[p].push_back(dir2);
-					}
-				}
+			catch (...) {
+				throw "リクエストの形式が間違っています。";
 			}
-			return;
 		}
 		catch (const char *s) {
-			throw s;
+			send(id + ",error," + s + "\n");
+			return;
+		}
+		// キャッシュに最適解があれば、探索せずに返す
+		if (cache_flg && cache_->apply(*state)) {
+			sw.Stop();
+			std::ostringstream oss;
+			write_result(oss, *state, sw, id + ",");
+			oss << id << ",end" << endl;
+			send(oss.str());
+			return;
 		}
-		catch (...) {
-			throw "問題ファイルとして解釈できませんでした。";
+		{
+			std::lock_guard<std::mutex> lock(mtx_);
+			++running_count_;
 		}
+		state->on_finish = [this, id, sw, send, cache_flg](SearchState &state) mutable {
+			sw.Stop();
+			if (cache_flg)
+				cache_->store(state.problem, true, state.best);
+			std::ostringstream oss;
+			write_result(oss, state, sw, id + ",");
+			oss << id << ",end" << endl;
+			send(oss.str());
+			std::lock_guard<std::mutex> lock(mtx_);
+			if (--running_count_ == 0)
+				idle_cv_.notify_all();
+		};
+		Solver::start(pool_, state, threads, pin_flg_);
 	}
-	// 辺の大きさを返す
-	size_t side_size() const noexcept {
-		return side_.size();
+public:
+	// コンストラクタ・デストラクタ
+	// (cache_fileが空でなければ、最適解1つだけを求めるリクエストに解のキャッシュを使う)
+	Server(const unsigned int threads, const bool pin_flg, const string &cache_file) : threads_(threads), pin_flg_(pin_flg), pool_(threads) {
+		if (!cache_file.empty())
+			cache_.reset(new SolutionCache(cache_file));
 	}
-	// 辺が使えるか否かを表すフラグ一覧(の初期値)を返す
-	vector<char> get_side_flg() const {
-		vector<char> side_flg(side_.size(), 0);
-		for (const auto &point : field_) {
-			for (const auto &dir : point) {
-				side_flg[dir.side_index] = 1;
+	~Server() { wait(); }
+	// 処理中のリクエストが無くなるまで待つ
+	void wait() {
+		std::unique_lock<std::mutex> lock(mtx_);
+		idle_cv_.wait(lock, [this] { return running_count_ == 0; });
+	}
+	// 入力ストリームからリクエストを読み、結果をsendで送り返す
+	// (入力が尽きるか「quit」を受け取ると戻る。結果は解き終えた時点で、ワーカースレッドから送られる)
+	void serve(std::istream &is, const std::function<void(const string&)> &send) {
+		string line;
+		while (std::getline(is, line)) {
+			if (!line.empty() && line.back() == '\r')
+				line.pop_back();
+			std::istringstream iss(line);
+			vector<string> token_list;
+			string token;
+			while (iss >> token) {
+				token_list.push_back(token);
 			}
+			// (問題文の後ろの改行などで生じた空行は読み飛ばす)
+			if (token_list.empty())
+				continue;
+			if (token_list[0] == "quit")
+				break;
+			start_request(token_list, is, send);
 		}
-		for (size_t i = 0; i < pre_root_.size() - 1; ++i) {
-			const auto index = get_index(pre_root_[i], pre_root_[i + 1]);
-			if(index >= 0)
-				side_flg[field_[pre_root_[i]][index].side_index] = 0;
+	}
+	// 標準入力からリクエストを受け付け、標準出力に結果を返す
+	void serve_stdin() {
+		std::mutex cout_mtx;
+		serve(std::cin, [&cout_mtx](const string &str) {
+			std::lock_guard<std::mutex> lock(cout_mtx);
+			cout << str << std::flush;
+		});
+		// (cout_mtxを使い終わるまで待つ)
+		wait();
+	}
+	// Unixドメインソケットで待ち受け、接続ごとにリクエストを受け付ける
+	// (プロセスが終了させられるまで戻らない)
+	void serve_socket(const string &path) {
+#ifdef _WIN32
+		(void)path;
+		throw "このOSでは、Unixドメインソケットでのサーバーモードに対応していません。";
+#else
+		// (接続先が切れた際に、書き込みでプロセスが終了しないようにする)
+		std::signal(SIGPIPE, SIG_IGN);
+		sockaddr_un address;
+		std::memset(&address, 0, sizeof(address));
+		address.sun_family = AF_UNIX;
+		if (path.size() >= sizeof(address.sun_path))
+			throw "ソケットのパスが長すぎます。";
+		path.copy(address.sun_path, path.size());
+		const int listen_fd = ::socket(AF_UNIX, SOCK_STREAM, 0);
+		if (listen_fd < 0)
+			throw "ソケットを作成できません。";
+		::unlink(path.c_str());
+		if (::bind(listen_fd, reinterpret_cast<const sockaddr*>(&address), sizeof(address)) < 0 || ::listen(listen_fd, 16) < 0) {
+			::close(listen_fd);
+			throw "ソケットで待ち受けできません。";
 		}
-		return side_flg;
+		while (true) {
+			const int fd = ::accept(listen_fd, nullptr, nullptr);
+			if (fd < 0) {
+				if (errno == EINTR)
+					continue;
+				break;
+			}
+			// 接続ごとに読み込み用のスレッドを立てる
+			// (接続は、そこから受け付けたリクエストの結果を全て送り終えるまで保持する)
+			auto connection = std::make_shared<Connection>(fd);
+			std::thread([this, connection] {
+				FdStreamBuf buffer(connection->fd());
+				std::istream is(&buffer);
+				serve(is, [connection](const string &str) { connection->send(str); });
+			}).detach();
+		}
+		::close(listen_fd);
+		throw "ソケットで接続を受け付けられません。";
+#endif
+	}
+};
+
+// 対話モード
+// 1手ずつ経路を延ばしながら、その都度「今の途中までの経路から始まる最適解」を求め直す(実際のプレイの支援用)
+// 次の情報を探索の間で引き継ぎ、2回目以降の探索を軽くする
+// ・これまでの探索で、部分問題ごとに見つけた経路
+//   今の途中までの経路から始まるものは、そのまま今の問題の解になるので、最も良いものを初期のベストスコアにする
+// ・直前に解いた問題の最適スコア
+//   手を進めても最適スコアは増えないので、これを見込みスコアの上限にし、そこに達したら探索を打ち切る
+//   (直前の最適解に沿って進めた場合は、初期のベストスコアが既にそこへ達しているので、探索自体を省ける)
+// ・先読みの結果
+//   最適解を出力した後、次の手の候補それぞれについて、手が入力されるまでの間にワーカースレッドで解き始めておく。
+//   入力された手の分は探索を続けてそのまま使い、それ以外の分は打ち切る
+class InteractiveSession {
+	Problem problem_;
+	unsigned int threads_;
+	bool pin_flg_;
+	ThreadPool pool_;
+	// これまでの探索で見つけた経路(スコア, 経路)
+	vector<std::pair<int, Result>> found_list_;
+	// 今の問題の最適スコアの上限
+	int upper_score_;
+	// 先読み中の探索
+	vector<std::shared_ptr<SearchState>> ponder_list_;
+	// 経路が、途中までの経路から始まっているか？
+	static bool starts_with(const Result &result, const vector<size_t> &pre_root) {
+		const auto root = result.get_root();
+		return (root.size() >= pre_root.size() && std::equal(pre_root.begin(), pre_root.end(), root.begin()));
+	}
+	// problemの探索を始める
+	// (引き継いだ経路が既に上限に達していれば、探索せずに、解き終えた状態で返す)
+	std::shared_ptr<SearchState> launch(const Problem &problem) {
+		auto state = std::make_shared<SearchState>(problem);
+		state->keep_found_flg = true;
+		state->upper_score = std::min(state->upper_score, upper_score_);
+		for (const auto &found : found_list_) {
+			if (state->best.second < found.first && starts_with(found.second, problem.get_pre_root())) {
+				state->best = std::pair<Result, int>(found.second, found.first);
+				state->best_score = found.first;
+			}
+		}
+		if (state->best.second >= state->upper_score) {
+			state->finish_flg = true;
+			return state;
+		}
+		// (シングルスレッドでも問題を分割しておき、部分問題ごとの経路を次の探索に残す)
+		Solver().prepare(*state, std::max(2u, threads_));
+		Solver::start(pool_, state, threads_, pin_flg_);
+		return state;
 	}
-	// ある地点の周りにある、まだ通れる辺の数の初期値を返す
-	// (ただしゴール地点だけ+1しておく)
-	vector<char> get_available_side_count() const {
-		vector<char> available_side_count(width_ * height_, 0);
-		for (size_t i = 0; i < field_.size(); ++i) {
-			available_side_count[i] = field_[i].size();
+	// 先読み中の探索のうち、途中までの経路がpre_rootと一致するもの以外を打ち切る
+	void cancel_ponder(const vector<size_t> &pre_root) {
+		vector<std::shared_ptr<SearchState>> ponder_list;
+		for (const auto &state : ponder_list_) {
+			if (state->problem.get_pre_root() == pre_root) {
+				ponder_list.push_back(state);
+				continue;
+			}
+			state->stop_flg = true;
+			state->wait();
 		}
-		available_side_count[goal_] += 1;
-		return available_side_count;
+		ponder_list_ = ponder_list;
 	}
-	// 角にゴールがあるか？
-	bool corner_goal_flg() const noexcept {
-		return (goal_ == 0 || goal_ == width_ - 1 || goal_ == width_ * (height_ - 1) || goal_ == width_ * height_ - 1);
+public:
+	// コンストラクタ・デストラクタ
+	InteractiveSession(const Problem &problem, const unsigned int threads, const bool pin_flg)
+		: problem_(problem), threads_(threads), pin_flg_(pin_flg), pool_(threads), upper_score_(problem.get_upper_score()) {}
+	~InteractiveSession() {
+		// (ワーカースレッドを止める前に、先読みを全て打ち切る)
+		cancel_ponder(vector<size_t>());
 	}
-	// 問題の奇偶を調べる
-	bool is_odd() const noexcept {
-		int sx = start_ % width_, sy = start_ / width_;
-		int gx = goal_ % width_, gy = goal_ / width_;
-		int x_flg = std::abs(sx - gx) % 2, y_flg = std::abs(sy - gy) % 2;
-		return ((x_flg + y_flg) % 2 == 1);
+	// 今の問題を解く
+	std::pair<Result, int> solve() {
+		// 先読みしていればそれを、していなければ新たに探索を始めて、解き終えるまで待つ
+		cancel_ponder(problem_.get_pre_root());
+		const auto state = (ponder_list_.empty() ? launch(problem_) : ponder_list_.front());
+		ponder_list_.clear();
+		state->wait();
+		// これまでに見つけた経路のうち、今の途中までの経路から始まるものだけを残す
+		// (手を戻すことは無いので、それ以外の経路は二度と使わない)
+		const auto &pre_root = problem_.get_pre_root();
+		found_list_.erase(std::remove_if(found_list_.begin(), found_list_.end(), [&pre_root](const std::pair<int, Result> &found) {
+			return !starts_with(found.second, pre_root);
+		}), found_list_.end());
+		found_list_.insert(found_list_.end(), state->found_list.begin(), state->found_list.end());
+		upper_score_ = state->best.second;
+		return state->best;
 	}
-	// 移動操作
+	// 次の手の候補それぞれについて、先読みを始める
+	// (最適解に沿った手の分は、探索せずに解き終えた状態になる)
+	void ponder() {
+		for (const auto &dir : problem_.get_dir_list(problem_.get_start())) {
+			if (!problem_.can_move(dir.next_position))
+				continue;
+			Problem next_problem = problem_;
+			next_problem.move(dir.next_position);
+			next_problem.optimize();
+			ponder_list_.push_back(launch(next_problem));
+		}
+	}
+	// 1手進める
 	void move(const size_t next_position) {
-		pre_root_.push_back(next_position);
-		pre_score_ = side_[field_[start_][get_index(start_, next_position)].side_index].calc(pre_score_);
-		start_ = next_position;
+		if (next_position >= problem_.get_width() * problem_.get_height() || !problem_.can_move(next_position))
+			throw "その地点には移動できません。";
+		problem_.move(next_position);
+		problem_.optimize();
+		// (入力された手以外の先読みは、もう使わないので打ち切る)
+		cancel_ponder(problem_.get_pre_root());
+	}
+	// 標準入力から手を読み、1手ごとに最適解を出力する
+	// (「move 地点番号 [地点番号...]」で手を進め、「quit」で終える。最初に、手を進める前の最適解を出力する)
+	void run() {
+		string line;
+		bool solve_flg = true;
+		do {
+			std::istringstream iss(line);
+			string command;
+			if (iss >> command) {
+				if (command == "quit")
+					break;
+				try {
+					if (command != "move")
+						throw "不明なコマンドです。";
+					int next_position;
+					while (iss >> next_position) {
+						if (next_position < 0)
+							throw "その地点には移動できません。";
+						move(next_position);
+						solve_flg = true;
+					}
+				}
+				catch (const char *s) {
+					cout << "エラー：" << s << endl;
+				}
+			}
+			if (!solve_flg)
+				continue;
+			StopWatch sw;
+			sw.Start();
+			const auto result = solve();
+			sw.Stop();
+			cout << problem_.get_width() << "," << problem_.get_height() << "," << result.second << "," << result.first << "," << (1.0 * sw.ElapsedMilliseconds() / 1000) << endl;
+			// (次の手が入力されるまでの間に、先読みを進めておく)
+			ponder();
+			solve_flg = false;
+		} while (std::getline(std::cin, line));
 	}
-	// 保存用に書き出す
-	string to_file() const {
+};
+
+// 検証モード
+// 乱数で作った小さな盤面を、全ての経路を調べ尽くす素朴な探索(参照解)と、ソルバーの各モードとで解き比べる
+// ・スコアが参照解と一致するか
+// ・経路が正しいか(途中までの経路から始まり、隣り合う地点を辿ってゴールで終わり、同じ辺を2回通らないか)
+// ・経路に沿ってOperation::calcで計算し直したスコアが、出力されたスコアと一致するか
+// を調べる。参照解はProblemを使わず、問題文を作る際の盤面データから直接求める
+class Verifier {
+	std::mt19937 rand_;
+	// 作った盤面
+	size_t width_, height_;
+	vector<Operation> side_;
+	// adjacency_[地点] = (隣の地点, 辺の番号)の一覧
+	vector<vector<std::pair<size_t, size_t>>> adjacency_;
+	// 途中までの経路(先頭がスタート地点)とゴール地点
+	vector<size_t> pre_root_;
+	size_t goal_;
+	// 問題文
+	string text_;
+	// 参照解を求める際の作業領域と結果
+	vector<int> side_flg_;
+	// ゴールに着いた経路のスコアのうち、上位のもの(降順)と、最高スコアに並ぶ経路の数
+	vector<int> top_score_list_;
+	size_t best_count_;
+	// ゴールに着いた経路の、スコアごとの数
+	std::map<int, uint64_t> route_histogram_;
+	// 不一致の数
+	size_t error_count_ = 0;
+	// 乱数で[min, max]の整数を返す
+	int rand_int(const int min, const int max) {
+		return std::uniform_int_distribution<int>(min, max)(rand_);
+	}
+	// 盤面を作る
+	// (実際の問題に近い割合で演算子を選ぶが、マイナスの多い盤面も混ぜておく)
+	void make_board() {
+		do {
+			width_ = rand_int(1, 5);
+			height_ = rand_int(1, 5);
+		} while (width_ * height_ > 16);
+		const int minus_rate = (rand_int(0, 3) == 0 ? 60 : 25);
+		side_.clear();
+		adjacency_.assign(width_ * height_, vector<std::pair<size_t, size_t>>());
 		std::ostringstream oss;
 		oss << width_ << " " << height_ << endl;
-		size_t p = 0;
 		for (size_t h = 0; h < height_ * 2 - 1; ++h) {
 			for (size_t w = 0; w < (h % 2 == 0 ? width_ - 1 : width_); ++w) {
-				if (w != 0) oss << " ";
-				oss << side_[p].str();
-				++p;
+				Operation ope;
+				const int r = rand_int(0, 99);
+				if (r < minus_rate) {
+					ope.add_num = -rand_int(1, 4);
+				}
+				else if (r < minus_rate + 15) {
+					ope.mul_num = rand_int(2, 3);
+				}
+				else {
+					ope.add_num = rand_int(1, 9);
+					ope.add_num_x = ope.add_num;
+				}
+				const size_t p = (h % 2 == 0 ? (h / 2) * width_ + w : ((h - 1) / 2) * width_ + w);
+				const size_t q = (h % 2 == 0 ? p + 1 : p + width_);
+				adjacency_[p].emplace_back(q, side_.size());
+				adjacency_[q].emplace_back(p, side_.size());
+				side_.push_back(ope);
+				oss << (w != 0 ? " " : "") << ope.str();
 			}
 			oss << endl;
 		}
-		oss << pre_root_.size() << " ";
-		for (size_t i = 0; i < pre_root_.size(); ++i) {
-			oss << pre_root_[i] << " ";
+		text_ = oss.str();
+	}
+	// スタート・ゴールと、途中までの経路を決める(with_pre_rootがfalseなら、途中までの経路は付けない)
+	void make_route(const bool with_pre_root) {
+		pre_root_.assign(1, rand_int(0, static_cast<int>(width_ * height_) - 1));
+		goal_ = rand_int(0, static_cast<int>(width_ * height_) - 1);
+		if (!with_pre_root)
+			return;
+		// 未使用の辺をランダムに1～3歩辿る
+		side_flg_.assign(side_.size(), 1);
+		const int steps = rand_int(1, 3);
+		for (int i = 0; i < steps; ++i) {
+			vector<std::pair<size_t, size_t>> candidate_list;
+			for (const auto &next : adjacency_[pre_root_.back()]) {
+				if (side_flg_[next.second])
+					candidate_list.push_back(next);
+			}
+			if (candidate_list.empty())
+				break;
+			const auto &next = candidate_list[rand_int(0, static_cast<int>(candidate_list.size()) - 1)];
+			side_flg_[next.second] = 0;
+			pre_root_.push_back(next.first);
 		}
-		oss << goal_ << endl;
-		return oss.str();
+		if (pre_root_.size() == 1)
+			return;
+		std::ostringstream oss;
+		oss << pre_root_.size();
+		for (const auto point : pre_root_) {
+			oss << " " << point;
+		}
+		oss << " " << goal_ << endl;
+		text_ += oss.str();
 	}
-	// 獲得可能な得点の上限を算出するための数値
-	void get_muladd_value(const vector<char> &side_flg, int &max_mul_value, int &max_add_value) const noexcept {
-		// 初期値
-		max_mul_value = 1; max_add_value = 0;
-		// 各辺についてチェックする
-		for (size_t i = 0; i < side_.size(); ++i) {
-			if (!side_flg[i])
+	// 参照解を求める(全ての経路を調べ尽くす)
+	void reference_dfs(const size_t now_position, const int score) {
+		if (now_position == goal_) {
+			top_score_list_.insert(std::upper_bound(top_score_list_.begin(), top_score_list_.end(), score, std::greater<int>()), score);
+			if (top_score_list_.size() > 3)
+				top_score_list_.pop_back();
+			if (score == top_score_list_.front())
+				best_count_ = (top_score_list_.size() >= 2 && top_score_list_[1] == score ? best_count_ + 1 : 1);
+			++route_histogram_[score];
+		}
+		for (const auto &next : adjacency_[now_position]) {
+			if (!side_flg_[next.second])
 				continue;
-			if (side_[i].add_num != 0) {
-				// 加減算
-				max_add_value += std::max(0, side_[i].add_num);
-			}
-			else if(side_[i].mul_num != 0){
-				// 乗算
-				max_mul_value *= std::max(1, side_[i].mul_num);
-			}
+			side_flg_[next.second] = 0;
+			reference_dfs(next.first, side_[next.second].calc(score));
+			side_flg_[next.second] = 1;
 		}
 	}
-	// getter
-	size_t get_start() const noexcept {
-		return start_;
-	}
-	size_t get_goal() const noexcept {
-		return goal_;
-	}
-	size_t get_width() const noexcept {
-		return width_;
-	}
-	size_t get_height() const noexcept {
-		return height_;
-	}
-	auto &get_pre_root() const noexcept {
-		return pre_root_;
-	}
-	const vector<Direction>& get_dir_list(const size_t point) const noexcept {
-		return field_[point];
-	}
-	const vector<Direction2>& get_dir_list2(const size_t point) const noexcept {
-		return field2_[point];
-	}
-	const Operation& get_operation(const size_t side_index) const noexcept {
-		return side_[side_index];
-	}
-	int get_pre_score() const noexcept {
-		return pre_score_;
-	}
-	// 出力用(等幅フォント用)
-	friend ostream& operator << (ostream& os, const Problem& problem) {
-		cout << "【問題】" << endl;
-		cout << "盤面の規模：" << problem.width_ << "x" << problem.height_ << endl;
-		cout << "初期得点：" << problem.pre_score_ << endl;
-		// リッチな表示にするため、表示用の文字列配列を用意
-		vector<vector<string>> output_board(problem.height_ * 2 + 1, vector<string>(problem.width_ * 2 + 1));
-		// とりあえず枠線を割り当てる
-		output_board[0][0] = "┌";
-		output_board[0][problem.width_ * 2] = "┐";
-		output_board[problem.height_ * 2][0] = "└";
-		output_board[problem.height_ * 2][problem.width_ * 2] = "┘";
-		for (size_t i = 0; i < problem.width_ - 1; ++i) {
-			output_board[0][i * 2 + 2] = "┬";
-			output_board[problem.height_ * 2][i * 2 + 2] = "┴";
-		}
-		for (size_t i = 0; i < problem.height_ - 1; ++i) {
-			output_board[i * 2 + 2][0] = "├";
-			output_board[i * 2 + 2][problem.width_ * 2] = "┤";
-		}
-		for (size_t j = 0; j < problem.height_ - 1; ++j) {
-			for (size_t i = 0; i < problem.width_ - 1; ++i) {
-				output_board[j * 2 + 2][i * 2 + 2] = "┼";
+	void solve_reference() {
+		side_flg_.assign(side_.size(), 1);
+		int score = 1;
+		for (size_t i = 1; i < pre_root_.size(); ++i) {
+			for (const auto &next : adjacency_[pre_root_[i - 1]]) {
+				if (next.first == pre_root_[i]) {
+					side_flg_[next.second] = 0;
+					score = side_[next.second].calc(score);
+				}
 			}
 		}
-		for (size_t j = 0; j < problem.height_ + 1; ++j) {
-			for (size_t i = 0; i < problem.width_; ++i) {
-				output_board[j * 2][i * 2 + 1] = "─";
+		top_score_list_.clear();
+		best_count_ = 0;
+		route_histogram_.clear();
+		reference_dfs(pre_root_.back(), score);
+	}
+	// 参照解の最高スコア(ゴールに着く経路が無ければ-9999)
+	int reference_score() const noexcept {
+		return (top_score_list_.empty() ? -9999 : top_score_list_.front());
+	}
+	// 経路を検証し、経路に沿って計算し直したスコアを返す(経路が正しくなければ例外を投げる)
+	int rescore(const Result &result, const vector<size_t> &pre_root, const size_t goal) const {
+		const auto root = result.get_root();
+		if (root.size() < pre_root.size() || !std::equal(pre_root.begin(), pre_root.end(), root.begin()))
+			throw "経路が途中までの経路から始まっていません。";
+		if (root.back() != goal)
+			throw "経路がゴールで終わっていません。";
+		vector<int> side_flg(side_.size(), 1);
+		int score = 1;
+		for (size_t i = 1; i < root.size(); ++i) {
+			bool move_flg = false;
+			for (const auto &next : adjacency_[root[i - 1]]) {
+				if (next.first != root[i])
+					continue;
+				if (!side_flg[next.second])
+					throw "経路が同じ辺を2回通っています。";
+				side_flg[next.second] = 0;
+				score = side_[next.second].calc(score);
+				move_flg = true;
 			}
+			if (!move_flg)
+				throw "経路が隣り合わない地点へ移動しています。";
 		}
-		for (size_t j = 0; j < problem.height_; ++j) {
-			for (size_t i = 0; i < problem.width_ + 1; ++i) {
-				output_board[j * 2 + 1][i * 2] = "│";
-			}
+		return score;
+	}
+	// 1つの解を検証する
+	void check(const string &mode, const std::pair<Result, int> &result, const int expected_score) {
+		string message;
+		if (result.second != expected_score) {
+			message = "スコアが " + std::to_string(result.second) + " (正しくは " + std::to_string(expected_score) + ")";
 		}
-		for (size_t j = 0; j < problem.height_; ++j) {
-			for (size_t i = 0; i < problem.width_; ++i) {
-				output_board[j * 2 + 1][i * 2 + 1] = "　";
+		else if (expected_score != -9999) {
+			try {
+				const int score = rescore(result.first, pre_root_, goal_);
+				if (score != result.second)
+					message = "経路を計算し直したスコアが " + std::to_string(score) + " (出力は " + std::to_string(result.second) + ")";
 			}
-		}
-		// セル間の罫線を、演算子に置き換える
-		for (size_t y = 0; y < problem.height_; ++y) {
-			for (size_t x = 0; x < problem.width_; ++x) {
-				size_t pos = y * problem.width_ + x;
-				const auto &dir_list = problem.field_[pos];
-				for (const auto &dir : dir_list) {
-					const auto &side = problem.side_[dir.side_index];
-					if (side.str() == "")
-						continue;
-					// 上
-					if (pos == dir.next_position + problem.width_) {
-						output_board[y * 2][x * 2 + 1] = side.str();
-					}
-					// 右
-					if (pos + 1 == dir.next_position) {
-						output_board[y * 2 + 1][x * 2 + 2] = side.str();
-					}
-					// 下
-					if (pos + problem.width_ == dir.next_position) {
-						output_board[y * 2 + 2][x * 2 + 1] = side.str();
-					}
-					// 左
-					if (pos == dir.next_position + 1) {
-						output_board[y * 2 + 1][x * 2] = side.str();
-					}
-				}
+			catch (const char *s) {
+				message = s;
 			}
 		}
-		// スタート・ゴールマークを入力する
+		if (!message.empty())
+			report(mode, message);
+	}
+	// 不一致を報告する(問題文も出力し、ファイルに保存すれば再現できるようにする)
+	void report(const string &mode, const string &message) {
+		++error_count_;
+		cout << "【不一致】" << mode << "：" << message << endl;
+		cout << "スタート地点 " << pre_root_.front() << "、ゴール地点 " << goal_ << "、問題文：" << endl << text_;
+	}
+	// スコアの一覧を文字列にする
+	static string to_string(const vector<int> &score_list) {
+		string str;
+		for (const auto score : score_list) {
+			str += (str.empty() ? "" : " ") + std::to_string(score);
+		}
+		return "[" + str + "]";
+	}
+	// 複数の解(上位K件・最高スコアに並ぶ全ての解)を検証する
+	void check_list(const string &mode, const vector<std::pair<int, Result>> &output_list, const vector<int> &expected_score_list) {
+		vector<int> score_list;
+		for (const auto &output : output_list) {
+			score_list.push_back(output.first);
+		}
+		if (score_list != expected_score_list) {
+			report(mode, "スコアの並びが " + to_string(score_list) + " (正しくは " + to_string(expected_score_list) + ")");
+			return;
+		}
+		for (const auto &output : output_list) {
+			check(mode, std::pair<Result, int>(output.second, output.first), output.first);
+		}
+	}
+	// ソルバーの各モードで解き、参照解と比べる
+	void verify_solver() {
+		std::istringstream iss(text_);
+		const Problem problem(iss, static_cast<int>(pre_root_.front()), static_cast<int>(goal_));
+		const int expected_score = reference_score();
+		Solver solver;
+		// シングルスレッド(通常の探索関数と、角にゴールがある場合の探索関数)
+		check("1スレッド", solver.solve_single(problem, false), expected_score);
+		if (problem.corner_goal_flg())
+			check("1スレッド(角ゴール)", solver.solve_single(problem, true), expected_score);
+		// 問題を分割し、複数スレッドで解く
+		for (unsigned int threads = 2; threads <= 4; ++threads) {
+			auto state = std::make_shared<SearchState>(problem);
+			solver.prepare(*state, threads);
+			Solver::solve(state, threads);
+			check(std::to_string(threads) + "スレッド", state->best, expected_score);
+		}
+		// 上位K件・最高スコアに並ぶ全ての解
+		for (unsigned int threads = 1; threads <= 3; threads += 2) {
+			auto state = std::make_shared<SearchState>(problem, 3);
+			solver.prepare(*state, threads);
+			Solver::solve(state, threads);
+			check_list(std::to_string(threads) + "スレッド・上位3件", state->get_output_list(), top_score_list_);
+		}
+		{
+			auto state = std::make_shared<SearchState>(problem, 0, true);
+			solver.prepare(*state, 2);
+			Solver::solve(state, 2);
+			check_list("2スレッド・全最適解", state->get_output_list(), vector<int>(best_count_, reference_score()));
+		}
+		// ポートフォリオモード(各探索設定を単独で試した後、全てを同時に動かす)
+		const auto config_list = PortfolioConfig::get_default_list(5);
+		for (const auto &config : config_list) {
+			auto state = std::make_shared<SearchState>(problem);
+			solver.prepare_portfolio(*state, vector<PortfolioConfig>(1, config));
+			Solver::solve(state, 1);
+			check("ポートフォリオ(" + config.str() + ")", state->best, expected_score);
+		}
 		{
-			// スタートマーク
-			size_t sx = problem.start_ % problem.width_;
-			size_t sy = problem.start_ / problem.width_;
-			output_board[sy * 2 + 1][sx * 2 + 1] = "Ｓ";
-			// ゴールマーク
-			size_t gx = problem.goal_ % problem.width_;
-			size_t gy = problem.goal_ / problem.width_;
-			output_board[gy * 2 + 1][gx * 2 + 1] = "Ｇ";
-		}
-		// 途中経路を入力する
+			auto state = std::make_shared<SearchState>(problem);
+			solver.prepare_portfolio(*state, config_list);
+			Solver::solve(state, static_cast<unsigned int>(config_list.size()));
+			check(std::to_string(config_list.size()) + "スレッド・ポートフォリオ", state->best, expected_score);
+		}
+		// 目標スコアを決めてから探索する(最適解の前後の目標スコアで、二分法・倍々の下げ幅を試す)
+		{
+			const int target = (expected_score == -9999 ? rand_int(-20, 20) : expected_score + rand_int(-20, 20));
+			const int window = rand_int(0, 3);
+			auto state = std::make_shared<SearchState>(problem);
+			solve_aspiration(state, 2, false, target, window);
+			check("2スレッド・目標スコア" + std::to_string(target) + "(下げ幅" + std::to_string(window) + ")", state->best, expected_score);
+		}
+		// ライブラリ用の入口(途中で見つけた解の通知が、スコアの昇順に最適解まで届くかも調べる)
+		{
+			SolveOption option;
+			option.threads = 2;
+			vector<int> improve_list;
+			option.on_improve = [&improve_list](const Result&, const int score) { improve_list.push_back(score); };
+			SolveJob job(problem, option);
+			job.wait();
+			check("2スレッド・ライブラリ", job.get_best(), expected_score);
+			if (!job.optimal_flg())
+				report("2スレッド・ライブラリ", "打ち切っていないのに最適解が確定していない");
+			const bool sorted_flg = std::is_sorted(improve_list.begin(), improve_list.end())
+				&& std::adjacent_find(improve_list.begin(), improve_list.end()) == improve_list.end();
+			if (!sorted_flg || (improve_list.empty() ? -9999 : improve_list.back()) != expected_score)
+				report("2スレッド・ライブラリ", "途中で見つけた解の通知が " + to_string(improve_list));
+		}
+		// 残りの辺が少なくなったら終盤の探索に切り替える(切り替える本数を変えて試す)
+		for (unsigned int threads = 1; threads <= 2; ++threads) {
+			const int endgame_size = rand_int(1, static_cast<int>(EndgameTable::max_edges));
+			auto state = std::make_shared<SearchState>(problem);
+			state->endgame_size = endgame_size;
+			solver.prepare(*state, threads);
+			Solver::solve(state, threads);
+			check(std::to_string(threads) + "スレッド・終盤の探索(" + std::to_string(endgame_size) + "本)", state->best, expected_score);
+		}
+		// 見込みスコアを奇偶で補正する
 		{
-			// 始点
-			size_t rp = problem.pre_root_[0];
-			size_t rx = rp % problem.width_;
-			size_t ry = rp / problem.width_;
-			if (output_board[ry * 2 + 1][rx * 2 + 1] == "　") {
-				output_board[ry * 2 + 1][rx * 2 + 1] = "○";
+			auto state = std::make_shared<SearchState>(problem);
+			state->parity_flg = true;
+			solver.prepare(*state, 1);
+			Solver::solve(state, 1);
+			check("1スレッド・奇偶による補正", state->best, expected_score);
+		}
+		// ゴールから逆向きに探索する
+		for (unsigned int threads = 1; threads <= 3; threads += 2) {
+			auto state = std::make_shared<SearchState>(problem);
+			BackwardSolver::solve(state, threads);
+			check(std::to_string(threads) + "スレッド・逆向きの探索", state->best, expected_score);
+		}
+		// 経路の数え上げ(スコアごとの経路の数を比べる)
+		for (unsigned int threads = 1; threads <= 2; ++threads) {
+			const auto result = RouteCounter(problem).count(threads);
+			if (result.histogram != route_histogram_) {
+				report(std::to_string(threads) + "スレッド・経路の数え上げ", "経路の数が " + std::to_string(result.total())
+					+ " (正しくは " + std::to_string(RouteCount{ route_histogram_ }.total()) + ")、またはスコアごとの数が異なる");
 			}
-			// 途中経路
-			size_t old_dir = 0;	//1から順に上・右・下・左であるものとする
-			for (size_t i = 1; i < problem.pre_root_.size(); ++i) {
-				// 上
-				if (rp == problem.pre_root_[i] + problem.width_) {
-					output_board[ry * 2][rx * 2 + 1] = "┃";
-					if (i > 1) {
-						switch (old_dir){
-						case 1:	//上上
-							output_board[ry * 2 + 1][rx * 2 + 1] = "┃";
-							break;
-						case 2:	//右上
-							output_board[ry * 2 + 1][rx * 2 + 1] = "┛";
-							break;
-						case 4:	//左上
-							output_board[ry * 2 + 1][rx * 2 + 1] = "┗";
-							break;
-						}
-					}
-					rp -= problem.width_;
-					ry--;
-					old_dir = 1;
-				}
-				// 右
-				if (rp + 1 == problem.pre_root_[i]) {
-					output_board[ry * 2 + 1][rx * 2 + 2] = "━";
-					if (i > 1) {
-						switch (old_dir) {
-						case 1:	//上右
-							output_board[ry * 2 + 1][rx * 2 + 1] = "┏";
-							break;
-						case 2:	//右右
-							output_board[ry * 2 + 1][rx * 2 + 1] = "━";
-							break;
-						case 3:	//下右
-							output_board[ry * 2 + 1][rx * 2 + 1] = "┗";
-							break;
-						}
-					}
-					rp += 1;
-					rx++;
-					old_dir = 2;
+		}
+		verify_interactive();
+	}
+	// 対話モードで1手ずつ進めながら解き、参照解と比べる
+	// (参照解を求め直すので、pre_root_は書き換わる)
+	void verify_interactive() {
+		std::istringstream iss(text_);
+		const Problem problem(iss, static_cast<int>(pre_root_.front()), static_cast<int>(goal_));
+		InteractiveSession session(problem, rand_int(1, 2), false);
+		for (int i = 0; i < 3; ++i) {
+			if (i != 0) {
+				// 未使用の辺からランダムに選んだ手で進める
+				// (行き止まりに入る手は対話モードが受け付けないので、そこで終える)
+				vector<size_t> candidate_list;
+				for (const auto &next : adjacency_[pre_root_.back()]) {
+					if (side_flg_[next.second])
+						candidate_list.push_back(next.first);
 				}
-				// 下
-				if (rp + problem.width_ == problem.pre_root_[i]) {
-					output_board[ry * 2 + 2][rx * 2 + 1] = "┃";
-					if (i > 1) {
-						switch (old_dir) {
-						case 2:	//右下
-							output_board[ry * 2 + 1][rx * 2 + 1] = "┓";
-							break;
-						case 3:	//下下
-							output_board[ry * 2 + 1][rx * 2 + 1] = "┃";
-							break;
-						case 4:	//左下
-							output_board[ry * 2 + 1][rx * 2 + 1] = "┏";
-							break;
-						}
-					}
-					rp += problem.width_;
-					ry++;
-					old_dir = 3;
+				if (candidate_list.empty())
+					break;
+				const size_t next_position = candidate_list[rand_int(0, static_cast<int>(candidate_list.size()) - 1)];
+				try {
+					session.move(next_position);
 				}
-				// 左
-				if (rp == problem.pre_root_[i] + 1) {
-					output_board[ry * 2 + 1][rx * 2] = "━";
-					if (i > 1) {
-						switch (old_dir) {
-						case 1:	//上左
-							output_board[ry * 2 + 1][rx * 2 + 1] = "┓";
-							break;
-						case 3:	//下左
-							output_board[ry * 2 + 1][rx * 2 + 1] = "┛";
-							break;
-						case 4:	//左左
-							output_board[ry * 2 + 1][rx * 2 + 1] = "━";
-							break;
-						}
-					}
-					rp -= 1;
-					rx--;
-					old_dir = 4;
+				catch (const char *) {
+					break;
 				}
+				pre_root_.push_back(next_position);
 			}
+			solve_reference();
+			check("対話モード(" + std::to_string(i) + "手目)", session.solve(), reference_score());
+			session.ponder();
+		}
+	}
+	// スタート・ゴールを自由に選ぶモードで解き、参照解と比べる
+	void verify_free() {
+		const int point_count = static_cast<int>(width_ * height_);
+		vector<size_t> start_list, goal_list;
+		for (int i = rand_int(1, 3); i > 0; --i) {
+			start_list.push_back(rand_int(0, point_count - 1));
 		}
-		// 結果を文字列に変換する
-		for (const auto &line : output_board) {
-			for (const auto &str : line) {
-				os << str;
+		for (int i = rand_int(1, 3); i > 0; --i) {
+			goal_list.push_back(rand_int(0, point_count - 1));
+		}
+		// 参照解は、組み合わせごとに求めたものの最大値とする
+		int expected_score = -9999;
+		for (const auto start : start_list) {
+			for (const auto goal : goal_list) {
+				pre_root_.assign(1, start);
+				goal_ = goal;
+				solve_reference();
+				expected_score = std::max(expected_score, reference_score());
 			}
-			os << endl;
 		}
-		return os;
-	}
-};
-
-// 解答データ
-class Result {
-	vector<size_t> root_;
-	size_t ptr_;
-public:
-	// コンストラクタ
-	Result(){}
-	Result(const size_t side_size, const size_t start) : ptr_(0) {
-		root_.resize(side_size);
-		root_[ptr_] = start;
-	}
-	// 辺を移動した際の操作
-	void move_side(const size_t point) noexcept {
-		++ptr_;
-		root_[ptr_] = point;
-	}
-	// 辺を戻した際の操作
-	void back_side() noexcept {
-		--ptr_;
-	}
-	void back_side2() noexcept {
-		ptr_ -= 2;
-	}
-	// 現在の位置
-	size_t now_position() const noexcept {
-		return root_[ptr_];
-	}
-	// getter
-	vector<size_t> get_root() const {
-		return vector<size_t>(root_.begin(), root_.begin() + ptr_ + 1);
-	}
-	// 出力用(等幅フォント用)
-	friend ostream& operator << (ostream& os, const Result& result) {
-		for (size_t i = 0; i <= result.ptr_; ++i) {
-			if (i != 0)
-				os << "->";
-			os << result.root_[i];
+		std::istringstream iss(text_);
+		const Problem problem(iss, static_cast<int>(start_list.front()), static_cast<int>(goal_list.front()));
+		Solver solver;
+		for (unsigned int threads = 1; threads <= 2; ++threads) {
+			auto state = std::make_shared<SearchState>(problem);
+			solver.prepare_free(*state, start_list, goal_list);
+			Solver::solve(state, threads);
+			// (経路の検証には、ソルバーが選んだスタート・ゴールを使う)
+			const auto root = state->best.first.get_root();
+			pre_root_.assign(1, root.front());
+			goal_ = root.back();
+			check(std::to_string(threads) + "スレッド・スタートとゴールを自由に選ぶ", state->best, expected_score);
 		}
-		return os;
 	}
-};
-
-// ソルバー
-size_t g_threads = 1;
-size_t g_max_threads;
-std::mutex mtx;
-int g_best_score = -9999;
-class Solver {
-	Problem problem_;
-	Result result_, best_result_;
-	int score_, best_score_;
-	vector<char> side_flg_;
-	vector<char> available_side_count_;
-	int max_mul_value_, max_add_value_;
-
-	// 普通の深さ優先探索を行う
-	std::pair<Result, int> dfs(const Problem &problem, const bool corner_goal_flg) {
-		problem_ = problem;
-		// 探索の起点となる解・最適解
-		best_result_ = result_ = Result(problem.side_size(), problem.get_start());
-		score_ = problem.get_pre_score();
-		best_score_ = -9999;
-		// ある辺を踏破したか？
-		side_flg_ = problem.get_side_flg();
-		// ある地点の周りにある、まだ通れる辺の数
-		// (ただしゴール地点だけ+1しておく)
-		available_side_count_ = problem.get_available_side_count();
-		// 獲得可能な得点の上限を算出するための数値
-		problem.get_muladd_value(side_flg_, max_mul_value_, max_add_value_);
-		// 探索開始
-		if (corner_goal_flg) {
-			// 始点と終点の奇偶を調べる
-			if (problem.is_odd()) {
-				dfs_cg_b(result_.now_position());
+	// 盤面の外を指す地点を含む問題が、読み込む時点でエラーになるかを調べる
+	// (サーバーモードのリクエストも同じ読み込みを通るので、壊れた問題でサーバーの状態を壊さないことの確認になる)
+	void verify_out_of_range() {
+		const int point_count = static_cast<int>(width_ * height_);
+		const string trailer_list[] = {
+			"1 0 " + std::to_string(point_count) + "\n",
+			"1 " + std::to_string(point_count) + " 0\n",
+			"2 0 " + std::to_string(point_count + 5) + " 0\n",
+		};
+		const std::pair<int, int> argument_list[] = { { point_count, -1 }, { -1, point_count } };
+		const auto expect_error = [this](const string &text, const int start_position, const int goal_position) {
+			try {
+				std::istringstream iss(text);
+				const Problem problem(iss, start_position, goal_position);
 			}
-			else {
-				dfs_cg_a(result_.now_position());
+			catch (const char*) {
+				return;
 			}
+			++error_count_;
+			cout << "【不一致】盤面の外の地点：エラーにならない(スタート地点 " << start_position << "、ゴール地点 " << goal_position << ")、問題文：" << endl << text;
+		};
+		for (const auto &trailer : trailer_list) {
+			expect_error(text_ + trailer, -1, -1);
 		}
-		else {
-			// 始点と終点の奇偶を調べる
-			if (problem.is_odd()) {
-				dfs_b(result_.now_position());
+		for (const auto &argument : argument_list) {
+			expect_error(text_, argument.first, argument.second);
+		}
+	}
+public:
+	// コンストラクタ
+	explicit Verifier(const unsigned int seed) : rand_(seed) {}
+	// count個の問題で検証し、不一致の数を返す
+	size_t run(const unsigned int count) {
+		for (unsigned int i = 0; i < count; ++i) {
+			make_board();
+			verify_out_of_range();
+			if (rand_int(0, 3) == 0) {
+				make_route(false);
+				verify_free();
 			}
 			else {
-				dfs_a(result_.now_position());
+				make_route(rand_int(0, 2) == 0);
+				solve_reference();
+				verify_solver();
 			}
 		}
-		Result best_result2(problem.side_size(), problem.get_pre_root()[0]);
-		for (size_t i = 1; i < problem.get_pre_root().size() - 1; ++i) {
-			best_result2.move_side(problem.get_pre_root()[i]);
-		}
-		for (size_t i = 0; i < best_result_.get_root().size(); ++i) {
-			best_result2.move_side(best_result_.get_root()[i]);
-		}
-		return std::pair<Result, int>(best_result2, best_score_);
-	}
-	void dfs_cg_a(const size_t now_position) noexcept {
-		// ゴール地点なら、とりあえずスコア判定を行う
-		if (now_position == problem_.get_goal()) {
-			if (score_ > best_score_) {
-				best_result_ = result_;
-				best_score_ = score_;
-				mtx.lock();
-				g_best_score = best_score_;
-				mtx.unlock();
-				//cout << best_result_.get_score() << "," << best_result_ << endl;
+		return error_count_;
+	}
+};
+
+// 生成モード
+// 盤面の大きさ・演算子の割合と数値の範囲・スタートとゴールの置き方を指定して、乱数で問題ファイルを作る
+// (盤面の大きさや演算子の割合で、ソルバーの速さがどう変わるかを測るのに使う。同じシードからは同じ問題ができる)
+// ・演算子は+・-・*を指定した割合で選び、数値はそれぞれの範囲から一様に選ぶ
+// ・スタート・ゴールは地点番号の他に、corner(四隅から選ぶ)・opposite(スタートと点対称の地点。ゴールのみ)・
+//   random(全地点から選ぶ)で指定できる。既定では四隅のどれかをスタート、その対角をゴールにする(角ゴール用の探索関数を使う)
+// ・較正する場合は、指定した大きさから1行・1列ずつ交互に盤面を広げ(目標より遅ければ狭め)ながらcalibration_samples問ずつ解き、
+//   解く時間の中央値が目標時間に最も近い(比で見て)大きさで問題を作る。1問ごとの探索は目標時間の4倍で打ち切る
+class BoardGenerator {
+	static const size_t calibration_samples = 3;
+	std::mt19937 rand_;
+	const GeneratorSetting setting_;
+	// 較正で問題を解くワーカースレッドの数
+	const unsigned int threads_;
+	// 乱数で[min, max]の整数を返す
+	int rand_int(const int min, const int max) {
+		return std::uniform_int_distribution<int>(min, max)(rand_);
+	}
+	// 演算を1つ選び、文字列にして返す
+	string make_operation() {
+		const int r = rand_int(0, setting_.op_rate[0] + setting_.op_rate[1] + setting_.op_rate[2] - 1);
+		const size_t kind = (r < setting_.op_rate[0] ? 0 : r < setting_.op_rate[0] + setting_.op_rate[1] ? 1 : 2);
+		return string(1, "+-*"[kind]) + std::to_string(rand_int(setting_.min_num[kind], setting_.max_num[kind]));
+	}
+	// 置き方specに従って地点を選ぶ(otherと同じ地点は選ばない。otherが無ければwidth*heightとする)
+	size_t choose_point(const string &spec, const size_t width, const size_t height, const size_t other) {
+		const size_t size = width * height;
+		vector<size_t> candidate_list;
+		if (spec == "corner") {
+			for (const auto point : { size_t(0), width - 1, (height - 1) * width, size - 1 }) {
+				if (point != other && std::find(candidate_list.begin(), candidate_list.end(), point) == candidate_list.end())
+					candidate_list.push_back(point);
 			}
-			return;
 		}
-		// 見込みスコアが現時点のベストスコアに劣っている場合は戻る
-		if ((score_ + max_add_value_) * max_mul_value_ < g_best_score)
-			return;
-		// ネストを深くする
-		--available_side_count_[now_position];
-		for (const auto &dir : problem_.get_dir_list2(now_position)) {
-			if (!side_flg_[dir.side_index1] || !side_flg_[dir.side_index2])
-				continue;
-			if (available_side_count_[dir.next_position2] <= 1)
-				continue;
-			// 進める
-			const int old_score = score_;
-			--available_side_count_[dir.next_position2];
-			result_.move_side(dir.next_position1);
-			result_.move_side(dir.next_position2);
-			score_ = dir.operation.calc(score_);
-			side_flg_[dir.side_index1] = 0;
-			side_flg_[dir.side_index2] = 0;
-			max_mul_value_ /= problem_.get_operation(dir.side_index1).mul_num;
-			max_mul_value_ /= problem_.get_operation(dir.side_index2).mul_num;
-			max_add_value_ -= problem_.get_operation(dir.side_index1).add_num_x;
-			max_add_value_ -= problem_.get_operation(dir.side_index2).add_num_x;
-			// 再帰を一段階深くする
-			dfs_cg_a(dir.next_position2);
-			// 戻す
-			side_flg_[dir.side_index1] = 1;
-			side_flg_[dir.side_index2] = 1;
-			max_mul_value_ *= problem_.get_operation(dir.side_index1).mul_num;
-			max_mul_value_ *= problem_.get_operation(dir.side_index2).mul_num;
-			max_add_value_ += problem_.get_operation(dir.side_index1).add_num_x;
-			max_add_value_ += problem_.get_operation(dir.side_index2).add_num_x;
-			result_.back_side2();
-			++available_side_count_[dir.next_position2];
-			score_ = old_score;
-		}
-		++available_side_count_[now_position];
-	}
-	void dfs_cg_b(const size_t now_position) noexcept {
-		// ゴール地点なら、とりあえずスコア判定を行う
-		if (now_position == problem_.get_goal()) {
-			if (score_ > best_score_) {
-				best_result_ = result_;
-				best_score_ = score_;
-				mtx.lock();
-				g_best_score = best_score_;
-				mtx.unlock();
-			}
-			return;
+		else if (spec == "opposite") {
+			if (other < size && size - 1 - other != other)
+				candidate_list.push_back(size - 1 - other);
 		}
-		// 見込みスコアが現時点のベストスコアに劣っている場合は戻る
-		if ((score_ + max_add_value_) * max_mul_value_ < g_best_score)
-			return;
-		// ネストを深くする
-		--available_side_count_[now_position];
-		for (const auto &dir : problem_.get_dir_list(now_position)) {
-			if (!side_flg_[dir.side_index])
-				continue;
-			if (available_side_count_[dir.next_position] <= 1)
-				continue;
-			// 進める
-			const int old_score = score_;
-			--available_side_count_[dir.next_position];
-			result_.move_side(dir.next_position);
-			score_ = problem_.get_operation(dir.side_index).calc(score_);
-			side_flg_[dir.side_index] = 0;
-			max_mul_value_ /= problem_.get_operation(dir.side_index).mul_num;
-			max_add_value_ -= problem_.get_operation(dir.side_index).add_num_x;
-			// 再帰を一段階深くする
-			dfs_cg_a(dir.next_position);
-			// 戻す
-			side_flg_[dir.side_index] = 1;
-			max_mul_value_ *= problem_.get_operation(dir.side_index).mul_num;
-			max_add_value_ += problem_.get_operation(dir.side_index).add_num_x;
-			result_.back_side();
-			++available_side_count_[dir.next_position];
-			score_ = old_score;
-		}
-		++available_side_count_[now_position];
-	}
-	void dfs_a(const size_t now_position) noexcept {
-		// ゴール地点なら、とりあえずスコア判定を行う
-		if (now_position == problem_.get_goal()) {
-			if (score_ > best_score_) {
-				best_result_ = result_;
-				best_score_ = score_;
-				mtx.lock();
-				g_best_score = best_score_;
-				mtx.unlock();
-				//cout << best_result_.get_score() << "," << best_result_ << endl;
+		else if (spec == "random") {
+			for (size_t point = 0; point < size; ++point) {
+				if (point != other)
+					candidate_list.push_back(point);
 			}
 		}
-		// 見込みスコアが現時点のベストスコアに劣っている場合は戻る
-		if ((score_ + max_add_value_) * max_mul_value_ < g_best_score)
-			return;
-		// ネストを深くする
-		--available_side_count_[now_position];
-		for (const auto &dir : problem_.get_dir_list2(now_position)) {
-			if (!side_flg_[dir.side_index1] || !side_flg_[dir.side_index2])
-				continue;
-			if (available_side_count_[dir.next_position2] <= 1)
-				continue;
-			// 進める
-			const int old_score = score_;
-			--available_side_count_[dir.next_position2];
-			result_.move_side(dir.next_position1);
-			result_.move_side(dir.next_position2);
-			score_ = dir.operation.calc(score_);
-			side_flg_[dir.side_index1] = 0;
-			side_flg_[dir.side_index2] = 0;
-			max_mul_value_ /= problem_.get_operation(dir.side_index1).mul_num;
-			max_mul_value_ /= problem_.get_operation(dir.side_index2).mul_num;
-			max_add_value_ -= problem_.get_operation(dir.side_index1).add_num_x;
-			max_add_value_ -= problem_.get_operation(dir.side_index2).add_num_x;
-			// 再帰を一段階深くする
-			dfs_a(dir.next_position2);
-			// 戻す
-			side_flg_[dir.side_index1] = 1;
-			side_flg_[dir.side_index2] = 1;
-			max_mul_value_ *= problem_.get_operation(dir.side_index1).mul_num;
-			max_mul_value_ *= problem_.get_operation(dir.side_index2).mul_num;
-			max_add_value_ += problem_.get_operation(dir.side_index1).add_num_x;
-			max_add_value_ += problem_.get_operation(dir.side_index2).add_num_x;
-			result_.back_side2();
-			++available_side_count_[dir.next_position2];
-			score_ = old_score;
-		}
-		++available_side_count_[now_position];
-	}
-	void dfs_b(const size_t now_position) noexcept {
-		// ゴール地点なら、とりあえずスコア判定を行う
-		if (now_position == problem_.get_goal()) {
-			if (score_ > best_score_) {
-				best_result_ = result_;
-				best_score_ = score_;
-				mtx.lock();
-				g_best_score = best_score_;
-				mtx.unlock();
-			}
-			return;
+		else {
+			const int point = std::stoi(spec);
+			if (point >= 0 && static_cast<size_t>(point) < size && static_cast<size_t>(point) != other)
+				candidate_list.push_back(point);
 		}
-		// 見込みスコアが現時点のベストスコアに劣っている場合は戻る
-		if ((score_ + max_add_value_) * max_mul_value_ < g_best_score)
-			return;
-		// ネストを深くする
-		--available_side_count_[now_position];
-		for (const auto &dir : problem_.get_dir_list(now_position)) {
-			if (!side_flg_[dir.side_index])
-				continue;
-			if (available_side_count_[dir.next_position] <= 1)
-				continue;
-			// 進める
-			const int old_score = score_;
-			--available_side_count_[dir.next_position];
-			result_.move_side(dir.next_position);
-			score_ = problem_.get_operation(dir.side_index).calc(score_);
-			side_flg_[dir.side_index] = 0;
-			max_mul_value_ /= problem_.get_operation(dir.side_index).mul_num;
-			max_add_value_ -= problem_.get_operation(dir.side_index).add_num_x;
-			// 再帰を一段階深くする
-			dfs_a(dir.next_position);
-			// 戻す
-			side_flg_[dir.side_index] = 1;
-			max_mul_value_ *= problem_.get_operation(dir.side_index).mul_num;
-			max_add_value_ += problem_.get_operation(dir.side_index).add_num_x;
-			result_.back_side();
-			++available_side_count_[dir.next_position];
-			score_ = old_score;
-		}
-		++available_side_count_[now_position];
+		if (candidate_list.empty())
+			throw "スタート・ゴールの置き方が間違っています。";
+		return candidate_list[rand_int(0, static_cast<int>(candidate_list.size()) - 1)];
 	}
-public:
-	// コンストラクタ
-	Solver() {}
-	// 解を探索する
-	std::pair<Result, int> solve(const Problem &problem, unsigned int threads) {
-		if (threads == 1) {
-			return dfs(problem, problem.corner_goal_flg());
-		}
-		problem_ = problem;
-		// 探索の起点となる解・最適解
-		best_result_ = result_ = Result(problem.side_size(), problem.get_start());
-		score_ = problem.get_pre_score();
-		best_score_ = -9999;
-		// ある辺を踏破したか？
-		side_flg_ = problem.get_side_flg();
-		// ある地点の周りにある、まだ通れる辺の数
-		// (ただしゴール地点だけ+1しておく)
-		available_side_count_ = problem.get_available_side_count();
-		// 始点
-		// 探索開始
-		const auto problem_list = split(problem, threads * 100);
-		vector<std::future<std::pair<Result, int>>> result_list_future;
-		ThreadPool pool(threads);
-		for (const auto &problem_temp : problem_list) {
-			result_list_future.emplace_back(
-				pool.enqueue([&] {
-				Solver new_solver;
-				return new_solver.dfs(problem_temp, problem_temp.corner_goal_flg());
-			})
-			);
-		}
-		vector<std::pair<Result, int>> result_list;
-		for (auto && result : result_list_future) {
-			result_list.emplace_back(result.get());
-		}
-		best_score_ = -9999;
-		for (size_t di = 0; di < result_list.size(); ++di) {
-			if (best_score_ < result_list[di].second) {
-				best_result_ = result_list[di].first;
-				best_score_ = result_list[di].second;
+	// 幅width・高さheightの問題を1つ作り、問題文を返す
+	string make_problem(const size_t width, const size_t height) {
+		std::ostringstream oss;
+		oss << width << " " << height << endl;
+		for (size_t h = 0; h < height * 2 - 1; ++h) {
+			for (size_t w = 0; w < (h % 2 == 0 ? width - 1 : width); ++w) {
+				oss << (w != 0 ? " " : "") << make_operation();
 			}
+			oss << endl;
 		}
-		return std::pair<Result, int>(best_result_, best_score_);
+		const size_t start = choose_point(setting_.start, width, height, width * height);
+		const size_t goal = choose_point(setting_.goal, width, height, start);
+		oss << 1 << " " << start << " " << goal << endl;
+		return oss.str();
 	}
-	// 問題を分割保存する
-	vector<Problem> split(const Problem &problem) const {
-		vector<Problem> splited_problem;
-		const auto side_flg = problem.get_side_flg();
-		for (const auto &dir : problem.get_dir_list(problem.get_start())) {
-			if (!side_flg[dir.side_index])
-				continue;
-			Problem next_problem = problem;
-			next_problem.move(dir.next_position);
-			splited_problem.push_back(next_problem);
+	// 問題を解く時間(ミリ秒)を測る(探索はtime_limitミリ秒で打ち切る)
+	long long measure(const string &text, const unsigned int time_limit) const {
+		std::istringstream iss(text);
+		const Problem problem(iss, -1, -1);
+		SolveOption option;
+		option.threads = threads_;
+		option.time_limit = time_limit;
+		StopWatch sw;
+		sw.Start();
+		SolveJob(problem, option).wait();
+		sw.Stop();
+		return sw.ElapsedMilliseconds();
+	}
+	// 幅width・高さheightの問題をcalibration_samples問作って解き、解く時間の中央値(ミリ秒)を返す
+	long long measure_median(const size_t width, const size_t height) {
+		vector<long long> time_list;
+		for (size_t i = 0; i < calibration_samples; ++i) {
+			time_list.push_back(measure(make_problem(width, height), setting_.calibrate_time * 4));
 		}
-		return splited_problem;
+		std::sort(time_list.begin(), time_list.end());
+		std::cerr << "較正：" << width << "x" << height << "の盤面は" << time_list[time_list.size() / 2] << "ミリ秒" << endl;
+		return time_list[time_list.size() / 2];
 	}
-	vector<Problem> split(const Problem &problem, unsigned int splits) const {
-		vector<Problem> splited_problem;
-		splited_problem.push_back(problem);
-		// ・splited_problemの各問題について、1段階分割した後にsplited_problem2に追記する
-		// ・splited_problemをsplited_problem2で上書きする
-		// ・上1つを続けると、nステップ目にsplited_problemの要素数がsplits以上になるのでループを抜ける
-		do {
-			vector<Problem> splited_problem2;
-			for (size_t i = 0; i < splited_problem.size(); ++i) {
-				const auto temp = split(splited_problem[i]);
-				for (const auto &q : temp) {
-					splited_problem2.push_back(q);
-				}
-				if (splited_problem2.size() + splited_problem.size() - i - 1 >= splits) {
-					for (size_t j = i + 1; j < splited_problem.size(); ++j) {
-						splited_problem2.push_back(splited_problem[j]);
-					}
-					break;
-				}
+	// 目標時間に最も近い盤面の大きさを探し、(幅, 高さ)を返す
+	std::pair<size_t, size_t> calibrate() {
+		const double target = setting_.calibrate_time;
+		std::pair<size_t, size_t> size(setting_.width, setting_.height);
+		long long time = measure_median(size.first, size.second);
+		const bool grow_flg = (time < target);
+		while (true) {
+			// (正方形に近づける向きに1行・1列だけ広げる・狭める)
+			std::pair<size_t, size_t> next_size = size;
+			if (grow_flg)
+				(next_size.first <= next_size.second ? next_size.first : next_size.second) += 1;
+			else
+				(next_size.first >= next_size.second ? next_size.first : next_size.second) -= 1;
+			if (next_size.first * next_size.second < 2 || next_size.first * next_size.second > 65535)
+				return size;
+			const long long next_time = measure_median(next_size.first, next_size.second);
+			if ((next_time < target) != grow_flg) {
+				// (目標時間を挟んだら、比で見て近い方を選ぶ。0ミリ秒は1ミリ秒として扱う)
+				const double ratio = target / std::max(1LL, time), next_ratio = target / std::max(1LL, next_time);
+				return (std::abs(std::log(ratio)) <= std::abs(std::log(next_ratio)) ? size : next_size);
 			}
-			if(splited_problem2.size() == 0)
-				break;
-			splited_problem.clear();
-			splited_problem = splited_problem2;
-
-		}while (splited_problem.size() < splits);
-		return splited_problem;
+			size = next_size;
+			time = next_time;
+		}
+	}
+public:
+	// コンストラクタ
+	BoardGenerator(const GeneratorSetting &setting, const unsigned int seed, const unsigned int threads)
+		: rand_(seed), setting_(setting), threads_(threads) {}
+	// 問題を作って書き出す
+	// (書き出し先の接頭辞があれば「<接頭辞>_<番号>.txt」に、無ければ標準出力に書き出す)
+	void run() {
+		const auto size = (setting_.calibrate_time != 0 ? calibrate() : std::pair<size_t, size_t>(setting_.width, setting_.height));
+		for (size_t i = 0; i < setting_.count; ++i) {
+			const string text = make_problem(size.first, size.second);
+			if (setting_.out_prefix.empty()) {
+				cout << text;
+				continue;
+			}
+			const size_t zero_count = std::to_string(setting_.count).size() - std::to_string(i + 1).size();
+			std::ofstream ofs(setting_.out_prefix + "_" + string(zero_count, '0') + std::to_string(i + 1) + ".txt");
+			if (ofs.fail())
+				throw "問題ファイルを書き出せません。";
+			ofs << text;
+		}
 	}
 };
 
@@ -1031,26 +1907,95 @@ int main(int argc, char* argv[]) {
 	try {
 		// コマンドライン引数から、ソフトウェアの動作設定を読み取る
 		Setting setting(argc, argv);
+		// 検証モード
+		if (setting.verify_count() != 0) {
+			StopWatch sw;
+			sw.Start();
+			const size_t error_count = Verifier(setting.seed()).run(setting.verify_count());
+			sw.Stop();
+			cout << "検証：" << setting.verify_count() << "問中、不一致" << error_count << "件(シード" << setting.seed() << "、" << (1.0 * sw.ElapsedMilliseconds() / 1000) << "秒)" << endl;
+			return (error_count == 0 ? 0 : EXIT_FAILURE);
+		}
+		// 生成モード
+		if (setting.generate_flg()) {
+			BoardGenerator(setting.generator(), setting.seed(), setting.split_count()).run();
+			return 0;
+		}
+		// トレースを記録する
+		// (探索を終えた時点で書き出す。Unixドメインソケットのサーバーモードは終わらないので書き出されない)
+		std::unique_ptr<Tracer> tracer;
+		if (!setting.trace_file().empty()) {
+			tracer.reset(new Tracer());
+			g_tracer = tracer.get();
+		}
+		// サーバーモード
+		if (setting.server_flg()) {
+			Server server(setting.split_count(), setting.pin_flg(), setting.cache_file());
+			if (setting.socket_path().empty())
+				server.serve_stdin();
+			else
+				server.serve_socket(setting.socket_path());
+			if (tracer)
+				tracer->write(setting.trace_file());
+			return 0;
+		}
 		// 問題ファイルを読み取る
 		Problem problem(setting.file_name(), setting.start_position(), setting.goal_position());
+		// 解のキャッシュを読み込む
+		std::unique_ptr<SolutionCache> cache;
+		if (!setting.cache_file().empty())
+			cache.reset(new SolutionCache(setting.cache_file()));
+		// 対話モード
+		if (setting.interactive_flg()) {
+			InteractiveSession(problem, setting.split_count(), setting.pin_flg()).run();
+			if (tracer)
+				tracer->write(setting.trace_file());
+			return 0;
+		}
+		// 経路を数えるモード
+		if (setting.routes_flg()) {
+			if (!setting.solver_flg())
+				throw "--routesは分割モードでは指定できません。";
+			count_routes(cout, problem, setting);
+			return 0;
+		}
 		//
 		if (setting.solver_flg()) {
 			// 解を探索する
 			{
-				Solver solver;
 				StopWatch sw;
 				sw.Start();
-				std::pair<Result, int> result = solver.solve(problem, setting.split_count());
+				const auto state = make_search_state(problem, setting, setting.split_count());
+				// (キャッシュに最適解があれば探索しない。途中までの解があれば、それを初期のベストスコアにする)
+				const bool cache_flg = (cache && setting.cacheable_flg());
+				if (!cache_flg || !cache->apply(*state)) {
+					if (setting.aspiration_mode() != ASPIRATION_NONE) {
+						const int target = get_aspiration_target(state, setting);
+						if (!state->finish_flg)
+							solve_aspiration(state, setting.split_count(), setting.pin_flg(), target, setting.aspiration_window());
+					}
+					else if (is_backward_search(problem, setting))
+						BackwardSolver::solve(state, setting.split_count());
+					else
+						Solver::solve(state, setting.split_count(), setting.pin_flg());
+					if (cache_flg)
+						cache->store(problem, true, state->best);
+				}
 				sw.Stop();
-				cout << problem.get_width() << "," << problem.get_height() << "," << result.second << "," << result.first << "," << (1.0 * sw.ElapsedMilliseconds() / 1000) << endl;
+				write_result(cout, *state, sw, "");
 			}
+			if (tracer)
+				tracer->write(setting.trace_file());
 			return 0;
 		}
 		else {
 			// 問題を分割保存する
 			// まず分割する
+			// (見込みスコアの高い順に並べ、ファイル番号の若い方から解けば良い解が早く見つかるようにする)
 			Solver solver;
-			const auto splited_problem = solver.split(problem, setting.split_count());
+			auto splited_problem = solver.split(problem, setting.split_count(), get_min_score(problem, setting, cache.get()));
+			std::stable_sort(splited_problem.begin(), splited_problem.end(),
+				[](const SplitTask &a, const SplitTask &b) { return a.upper_score > b.upper_score; });
 			// ファイル保存のための準備をする
 			string file_name_without_ext;
 			string::size_type pos = setting.file_name().find_last_of(".");
@@ -1061,11 +2006,19 @@ int main(int argc, char* argv[]) {
 				file_name_without_ext = setting.file_name().substr(0, pos);
 			}
 			// 保存処理
+			// (ジョブファイルを指定した場合は、盤面を「<元のファイル名>_board.txt」に1つだけ書き出し、
+			//   部分問題はジョブファイルにまとめる)
+			if (!setting.job_file().empty()) {
+				std::ofstream ofs(file_name_without_ext + "_board.txt");
+				ofs << problem.to_file();
+				write_job_file(setting.job_file(), problem, splited_problem);
+				return 0;
+			}
 			for (size_t i = 0; i < splited_problem.size(); ++i) {
 				int zero_count = std::to_string(splited_problem.size()).size() - std::to_string(i + 1).size();
 				const auto hoge = file_name_without_ext + "_" + string(zero_count, '0') + std::to_string(i + 1) + ".txt";
 				std::ofstream ofs(file_name_without_ext + "_" + string(zero_count, '0') + std::to_string(i + 1) + ".txt");
-				ofs << splited_problem[i].to_file();
+				ofs << problem.to_file(splited_problem[i].route);
 			}
 		}
 	}
@@ -0,0 +1,136 @@
+﻿#include "challerun_c.h"
+#include "challerun.h"
+#include <cstddef>
+#include <cstring>
+
+struct challerun_problem {
+	Problem problem;
+};
+struct challerun_job {
+	std::unique_ptr<SolveJob> job;
+};
+
+namespace {
+	// 呼び出したスレッドで最後に失敗した理由
+	thread_local string last_error;
+	// 失敗した理由を記録する
+	void set_last_error(const char *message) {
+		last_error = message;
+	}
+	// 経路を地点番号の列にする
+	vector<int> get_route(const Result &result) {
+		const auto root = result.get_root();
+		return vector<int>(root.begin(), root.end());
+	}
+}
+
+void challerun_option_init_size(challerun_option *option, size_t struct_size) {
+	// 呼び出し側の構造体に無い項目は書き込まない
+	const SolveOption default_option;
+	challerun_option c_option;
+	c_option.struct_size = std::min(struct_size, sizeof(challerun_option));
+	c_option.threads = default_option.threads;
+	c_option.pin = (default_option.pin_flg ? 1 : 0);
+	c_option.time_limit = default_option.time_limit;
+	c_option.endgame_size = static_cast<unsigned int>(default_option.endgame_size);
+	c_option.parity = (default_option.parity_flg ? 1 : 0);
+	c_option.on_improve = nullptr;
+	c_option.user_data = nullptr;
+	std::memcpy(option, &c_option, c_option.struct_size);
+}
+
+challerun_problem* challerun_problem_load(const char *text, size_t size, int start_position, int goal_position) {
+	try {
+		std::istringstream iss(string(text, size));
+		return new challerun_problem{ Problem(iss, start_position, goal_position) };
+	}
+	catch (const char *s) {
+		set_last_error(s);
+	}
+	catch (...) {
+		set_last_error("問題を読み込めません。");
+	}
+	return nullptr;
+}
+
+void challerun_problem_free(challerun_problem *problem) {
+	delete problem;
+}
+
+challerun_job* challerun_job_start(const challerun_problem *problem, const challerun_option *option) {
+	try {
+		challerun_option c_option;
+		challerun_option_init(&c_option);
+		if (option != nullptr) {
+			// 呼び出し側の構造体に無い項目は、既定値のままにする
+			if (option->struct_size < offsetof(challerun_option, user_data) + sizeof(option->user_data))
+				throw "設定の構造体の大きさが正しくありません。";
+			std::memcpy(&c_option, option, std::min(option->struct_size, sizeof(challerun_option)));
+		}
+		if (c_option.endgame_size > EndgameTable::max_edges)
+			throw "終盤の探索に切り替える辺の数が大きすぎます。";
+		SolveOption solve_option;
+		solve_option.threads = c_option.threads;
+		solve_option.pin_flg = (c_option.pin != 0);
+		solve_option.time_limit = c_option.time_limit;
+		solve_option.endgame_size = c_option.endgame_size;
+		solve_option.parity_flg = (c_option.parity != 0);
+		if (c_option.on_improve != nullptr) {
+			const auto on_improve = c_option.on_improve;
+			const auto user_data = c_option.user_data;
+			solve_option.on_improve = [on_improve, user_data](const Result &result, const int score) {
+				const auto route = get_route(result);
+				on_improve(user_data, score, route.data(), route.size());
+			};
+		}
+		return new challerun_job{ std::unique_ptr<SolveJob>(new SolveJob(problem->problem, solve_option)) };
+	}
+	catch (const char *s) {
+		set_last_error(s);
+	}
+	catch (...) {
+		set_last_error("探索を始められません。");
+	}
+	return nullptr;
+}
+
+void challerun_job_cancel(challerun_job *job) {
+	job->job->cancel();
+}
+
+int challerun_job_wait(challerun_job *job, int timeout) {
+	if (timeout < 0) {
+		job->job->wait();
+		return 1;
+	}
+	return (job->job->wait_for(static_cast<unsigned int>(timeout)) ? 1 : 0);
+}
+
+int challerun_job_optimal(const challerun_job *job) {
+	return (job->job->optimal_flg() ? 1 : 0);
+}
+
+int challerun_job_result(const challerun_job *job, int *score, int *route, size_t capacity, size_t *route_size) {
+	const auto best = job->job->get_best();
+	if (best.second == -9999) {
+		set_last_error("解が見つかっていません。");
+		return 0;
+	}
+	const auto root = get_route(best.first);
+	*score = best.second;
+	*route_size = root.size();
+	if (root.size() > capacity) {
+		set_last_error("経路を入れる領域が足りません。");
+		return 0;
+	}
+	std::copy(root.begin(), root.end(), route);
+	return 1;
+}
+
+void challerun_job_free(challerun_job *job) {
+	delete job;
+}
+
+const char* challerun_last_error(void) {
+	return last_error.c_str();
+}
@@ -0,0 +1,86 @@
+﻿#ifndef CHALLERUN_C_H
+#define CHALLERUN_C_H
+
+// 他のプログラムから使うためのC言語向けインターフェース
+// (challerunLibのDLL・共有ライブラリが公開する。C++から使う場合は、challerun.hのSolveJobを直接使っても良い)
+// ・問題は、format.txtの形式の問題文をメモリ上の文字列で渡す
+// ・探索はchallerun_job_startで始まり、別のスレッドで進む。challerun_job_waitで待ち、challerun_job_cancelで打ち切る
+// ・経路は、スタート地点からゴール地点までの地点番号の列で表す
+// ・失敗した関数はNULLか0を返し、challerun_last_errorでその理由(呼び出したスレッドで最後に起きたもの)を取得できる
+// ・challerun_problem・challerun_jobは、それぞれ対応する_free関数で解放する
+
+#include <stddef.h>
+
+#if defined(_WIN32) && defined(CHALLERUN_EXPORTS)
+#define CHALLERUN_API __declspec(dllexport)
+#elif defined(_WIN32)
+#define CHALLERUN_API __declspec(dllimport)
+#elif defined(__GNUC__)
+#define CHALLERUN_API __attribute__((visibility("default")))
+#else
+#define CHALLERUN_API
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct challerun_problem challerun_problem;
+typedef struct challerun_job challerun_job;
+
+// ベストスコアを更新するたびに呼ばれる関数
+// (ワーカースレッドから呼ばれる。routeは呼び出しの間だけ有効で、探索を止めないよう手短に済ませること)
+typedef void (*challerun_improve_callback)(void *user_data, int score, const int *route, size_t route_size);
+
+// 探索の設定(challerun_option_initで既定値にしてから書き換える)
+// (項目は後ろに追加していくだけにし、ライブラリはstruct_sizeの範囲の項目だけを読む。
+//   古いヘッダーで作ったプログラムも、そのまま新しいライブラリで動く)
+typedef struct challerun_option {
+	// この構造体の大きさ(challerun_option_initが入れるので、書き換えないこと)
+	size_t struct_size;
+	// ワーカースレッドの数(0ならCPUのコア数)
+	unsigned int threads;
+	// ワーカースレッドをCPUコアに固定するか(0以外なら固定する)
+	int pin;
+	// 探索時間の上限(ミリ秒。0なら無制限)
+	unsigned int time_limit;
+	// 残りの辺がこの本数以下になったら、終盤の探索に切り替える(0なら切り替えない)
+	unsigned int endgame_size;
+	// ベストスコアを更新するたびに呼ばれる関数(NULLなら呼ばない)と、それに渡す値
+	challerun_improve_callback on_improve;
+	void *user_data;
+	// 見込みスコアを奇偶で補正するか(0以外なら補正する。ここから後ろはstruct_sizeが足りなければ既定値を使う)
+	int parity;
+} challerun_option;
+
+// 設定を既定値にする(struct_sizeには、呼び出し側の構造体の大きさを渡す。通常はchallerun_option_initを使う)
+CHALLERUN_API void challerun_option_init_size(challerun_option *option, size_t struct_size);
+#define challerun_option_init(option) challerun_option_init_size((option), sizeof(challerun_option))
+
+// 問題文textのsizeバイトを読み込む(スタート・ゴール地点が-1なら、問題文に書かれたものを使う)
+CHALLERUN_API challerun_problem* challerun_problem_load(const char *text, size_t size, int start_position, int goal_position);
+CHALLERUN_API void challerun_problem_free(challerun_problem *problem);
+
+// 探索を始める(optionがNULLなら既定値を使う。problemは、この関数から戻ったら解放して良い)
+CHALLERUN_API challerun_job* challerun_job_start(const challerun_problem *problem, const challerun_option *option);
+// 探索を打ち切る(別のスレッドからも呼べる)
+CHALLERUN_API void challerun_job_cancel(challerun_job *job);
+// 解き終えるまで、最大でtimeoutミリ秒だけ待つ(解き終えていれば1、そうでなければ0を返す。timeoutが負なら解き終えるまで待つ)
+CHALLERUN_API int challerun_job_wait(challerun_job *job, int timeout);
+// 打ち切らずに解き終え、最適解が確定したか(確定していれば1を返す)
+CHALLERUN_API int challerun_job_optimal(const challerun_job *job);
+// 今までに見つけた最も良い解を取得する
+// (scoreにスコアを、routeに最大capacity個の地点番号を、route_sizeに経路の地点数を入れる。
+//   解が無ければ0を返す。capacityが足りなければroute_sizeだけ入れて0を返すので、確保し直して呼び直す)
+CHALLERUN_API int challerun_job_result(const challerun_job *job, int *score, int *route, size_t capacity, size_t *route_size);
+// 探索を打ち切り、終わるのを待ってから解放する
+CHALLERUN_API void challerun_job_free(challerun_job *job);
+
+// 呼び出したスレッドで最後に失敗した理由を返す(失敗していなければ空文字列)
+CHALLERUN_API const char* challerun_last_error(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif